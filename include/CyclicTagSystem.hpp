@@ -1,13 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
 #include <deque>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
 #include "AbstractMachine.hpp"
+#include "SpillQueue.hpp"
+#include "Sweep.hpp"
 #include "Utils.hpp"
 
 namespace machines {
@@ -16,10 +21,163 @@ class TSConverter;
 
 namespace cts {
 
+// Ring buffer of bits packed into a power of two 64-bit words, so positions
+// wrap with a mask. A production is appended word by word, shifted to the bit
+// after the last one, and may write over the free words behind it: the buffer
+// keeps two of them free on top of the bits appended. A full buffer doubles
+// and is unrolled to start at the first bit.
+class BitQueue final {
+public:
+  using Word = std::uint64_t;
+  using WordStorage = std::vector<Word>;
+
+  static constexpr size_t WordBits = 64U;
+
+  // Bits packed the way the queue keeps them, the first bit being the lowest
+  // bit of the first word.
+  struct Bits final {
+    WordStorage words_;
+    size_t size_ = 0U;
+  };
+
+  template <typename Iter> static Bits pack(Iter first, Iter last) {
+    Bits bits;
+    for (; first != last; ++first, ++bits.size_) {
+      if (bits.size_ % WordBits == 0)
+        bits.words_.push_back(0U);
+      bits.words_.back() |= Word{*first} << (bits.size_ % WordBits);
+    }
+    return bits;
+  }
+
+private:
+  static constexpr size_t MinWords = 4U;
+
+  WordStorage words_ = WordStorage(MinWords);
+  size_t first_ = 0U;
+  size_t size_ = 0U;
+
+  size_t mask() const noexcept { return words_.size() * WordBits - 1; }
+
+  size_t wordMask() const noexcept { return words_.size() - 1; }
+
+  // Word of the bits from buffer position pos on, wrapping around.
+  Word wordAt(size_t pos) const noexcept {
+    pos &= mask();
+    auto indx = pos / WordBits, shift = pos % WordBits;
+    auto word = words_[indx] >> shift;
+    if (shift != 0)
+      word |= words_[(indx + 1) & wordMask()] << (WordBits - shift);
+    return word;
+  }
+
+  void grow(size_t size) {
+    auto count = words_.size();
+    while (count * WordBits < size + 2 * WordBits)
+      count *= 2;
+    if (count == words_.size())
+      return;
+    WordStorage words(count);
+    for (size_t i = 0; i * WordBits < size_; ++i)
+      words[i] = wordAt(first_ + i * WordBits);
+    words_ = std::move(words);
+    first_ = 0U;
+  }
+
+public:
+  bool empty() const noexcept { return size_ == 0; }
+
+  size_t size() const noexcept { return size_; }
+
+  bool operator[](size_t pos) const noexcept {
+    pos = (first_ + pos) & mask();
+    return words_[pos / WordBits] >> (pos % WordBits) & 1U;
+  }
+
+  bool front() const noexcept { return (*this)[0]; }
+
+  // Word of the bits from pos on, those past the last bit being arbitrary.
+  Word word(size_t pos) const noexcept { return wordAt(first_ + pos); }
+
+  void pop(size_t count = 1U) noexcept {
+    first_ = (first_ + count) & mask();
+    size_ -= count;
+  }
+
+  // Number of 0 bits at the front, counting at most max of them. Finds the
+  // first 1 a word at a time.
+  size_t countZeros(size_t max) const noexcept {
+    max = std::min(max, size_);
+    for (size_t count = 0; count < max; count += WordBits) {
+      auto word = wordAt(first_ + count);
+      if (word != 0)
+        return std::min<size_t>(max, count + __builtin_ctzll(word));
+    }
+    return max;
+  }
+
+  void append(const Bits &bits) {
+    if (bits.size_ == 0)
+      return;
+    grow(size_ + bits.size_);
+    auto last = (first_ + size_) & mask();
+    auto indx = last / WordBits, shift = last % WordBits;
+    const auto &src = bits.words_;
+    if (shift == 0) {
+      for (size_t i = 0; i != src.size(); ++i)
+        words_[(indx + i) & wordMask()] = src[i];
+    } else {
+      auto &word = words_[indx];
+      word = (word & ((Word{1} << shift) - 1)) | src[0] << shift;
+      for (size_t i = 1; i != src.size(); ++i)
+        words_[(indx + i) & wordMask()] =
+            src[i - 1] >> (WordBits - shift) | src[i] << shift;
+      words_[(indx + src.size()) & wordMask()] =
+          src.back() >> (WordBits - shift);
+    }
+    size_ += bits.size_;
+  }
+
+  template <typename Iter> void append(Iter first, Iter last) {
+    append(pack(first, last));
+  }
+
+  // Calls visit(bool) for the first count bits.
+  template <typename Visit> void forEach(size_t count, Visit visit) const {
+    for (size_t pos = 0; pos < count; pos += WordBits) {
+      auto word = wordAt(first_ + pos);
+      auto end = std::min(count - pos, WordBits);
+      for (size_t bit = 0; bit != end; ++bit)
+        visit(static_cast<bool>(word >> bit & 1U));
+    }
+  }
+
+  template <typename Visit> void forEach(Visit visit) const {
+    forEach(size_, visit);
+  }
+};
+
 class Tags final {
 public:
   using Symbol = bool;
   using Tag = std::deque<Symbol>;
+  using PosStorage = std::vector<size_t>;
+
+  // Tag kept as the positions of its Y, the N between them being implicit.
+  struct SparseTag final {
+    PosStorage ys_;
+    size_t size_ = 0U;
+  };
+
+  static SparseTag toSparse(const Tag &tag) {
+    SparseTag sparse;
+    for (auto &&sym : tag) {
+      if (sym)
+        sparse.ys_.push_back(sparse.size_);
+      ++sparse.size_;
+    }
+    return sparse;
+  }
 
   static Tag strToTag(std::string_view str) {
     Tag tag;
@@ -67,10 +225,23 @@ private:
   };
 
   using TagStorage = std::vector<Tag>;
+  using BitsStorage = std::vector<BitQueue::Bits>;
+  using SparseStorage = std::vector<SparseTag>;
   using HaltTagStorage = std::unordered_set<Tag, TagHash, TagEqual>;
+  using Word = BitQueue::Word;
+  using HaltKeyMap = std::unordered_multimap<Word, size_t>;
+
+  static constexpr size_t WordBits = BitQueue::WordBits;
 
   TagStorage tags_;
+  BitsStorage bits_;
   HaltTagStorage halts_;
+  BitsStorage haltBits_;
+  HaltKeyMap haltKeys_;
+  SparseStorage sparse_;
+  SparseStorage sparseHalts_;
+  size_t maxHaltYs_ = 0U;
+  bool oneHot_ = false;
 
   void readTable(std::istream &is) {
     std::string pat, tagStr;
@@ -78,8 +249,12 @@ private:
     utils::checkPattern(pat, "table:");
     std::getline(is, pat);
     auto iss = utils::readLineToSS(is);
-    while (iss >> tagStr)
+    while (iss >> tagStr) {
       tags_.emplace_back(strToTag(tagStr));
+      bits_.emplace_back(BitQueue::pack(tags_.back().begin(),
+                                        tags_.back().end()));
+      sparse_.emplace_back(toSparse(tags_.back()));
+    }
   }
 
   bool checkHaltsSize() const {
@@ -100,6 +275,51 @@ private:
       auto msg = "Halts tags have different size";
       throw std::runtime_error(msg);
     }
+    for (auto &&halt : halts_) {
+      auto bits = BitQueue::pack(halt.begin(), halt.end());
+      haltKeys_.emplace(bits.words_.empty() ? 0U : bits.words_[0],
+                        haltBits_.size());
+      haltBits_.push_back(std::move(bits));
+      sparseHalts_.emplace_back(toSparse(halt));
+      maxHaltYs_ = std::max(maxHaltYs_, sparseHalts_.back().ys_.size());
+    }
+  }
+
+  // Tells whether every production and halt tag is made of blocks as long as
+  // the halt tags holding a single Y each, as TSConverter writes them.
+  bool checkOneHot() const {
+    auto width = haltSize();
+    auto oneHot = [width](const SparseTag &tag) {
+      if (tag.size_ % width != 0 || tag.ys_.size() != tag.size_ / width)
+        return false;
+      for (size_t i = 0; i != tag.ys_.size(); ++i)
+        if (tag.ys_[i] / width != i)
+          return false;
+      return true;
+    };
+    return width > 1 && std::all_of(sparse_.begin(), sparse_.end(), oneHot) &&
+           std::all_of(sparseHalts_.begin(), sparseHalts_.end(), oneHot);
+  }
+
+  // Bits of the word indx of the front the halt tags cover.
+  Word haltMask(size_t indx) const noexcept {
+    auto bits = haltSize() - indx * WordBits;
+    return bits >= WordBits ? ~Word{0} : (Word{1} << bits) - 1;
+  }
+
+  // Halt tags are packed and keyed by their first word, so the front is
+  // matched with words read off it by wordAt(indx).
+  template <typename WordAt> bool matchHalt(WordAt wordAt) const {
+    auto range = haltKeys_.equal_range(wordAt(0U) & haltMask(0U));
+    for (auto it = range.first; it != range.second; ++it) {
+      const auto &words = haltBits_[it->second].words_;
+      auto match = true;
+      for (size_t indx = 1; match && indx < words.size(); ++indx)
+        match = (wordAt(indx) & haltMask(indx)) == words[indx];
+      if (match)
+        return true;
+    }
+    return false;
   }
 
   void dumpTable(std::ostream &os) const {
@@ -123,6 +343,7 @@ public:
   void read(std::istream &is) {
     readTable(is);
     readHalt(is);
+    oneHot_ = checkOneHot();
   }
 
   void dump(std::ostream &os) const {
@@ -136,12 +357,38 @@ public:
 
   const Tag &getTag(size_t indx) const { return tags_.at(indx); }
 
-  bool isHlt(const Tag &tag) const {
-    if (tag.size() < haltSize()) {
+  // Production packed for BitQueue::append.
+  const BitQueue::Bits &getBits(size_t indx) const { return bits_[indx]; }
+
+  const SparseTag &getSparse(size_t indx) const { return sparse_[indx]; }
+
+  // Productions and halt tags are one-hot blocks, see checkOneHot().
+  bool isOneHot() const noexcept { return oneHot_; }
+
+  // Prefixes of the queue need no more Y than this to be checked.
+  size_t maxHaltYs() const noexcept { return maxHaltYs_; }
+
+  // Checks the front of the queue in place, without copying it.
+  bool isHlt(const BitQueue &queue) const {
+    if (queue.size() < haltSize())
       return false;
-    }
-    auto cutTag = Tag{tag.begin(), tag.begin() + haltSize()};
-    return halts_.count(cutTag);
+    return matchHalt(
+        [&queue](size_t indx) { return queue.word(indx * WordBits); });
+  }
+
+  // Prefix of haltSize() bits packed by BitQueue::pack.
+  bool isHlt(const BitQueue::Bits &prefix) const {
+    const auto &words = prefix.words_;
+    return matchHalt([&words](size_t indx) {
+      return indx < words.size() ? words[indx] : Word{0};
+    });
+  }
+
+  // Positions of the Y in a prefix of haltSize() bits.
+  bool isHlt(const PosStorage &prefix) const {
+    return std::any_of(
+        sparseHalts_.begin(), sparseHalts_.end(),
+        [&prefix](const SparseTag &halt) { return halt.ys_ == prefix; });
   }
 
   TagIter begin() const noexcept { return tags_.begin(); }
@@ -154,11 +401,13 @@ public:
 };
 
 class CyclicTagSystem : public Machine<CyclicTagSystem> {
-  using Queue = Tags::Tag;
+  using Queue = BitQueue;
 
   Tags tags_;
   Queue queue_;
   size_t indx_;
+  size_t spillCap_ = 0U;
+  bool unlimited_ = false;
 
   void read(std::istream &is) {
     tags_.read(is);
@@ -167,51 +416,264 @@ class CyclicTagSystem : public Machine<CyclicTagSystem> {
     utils::checkPattern(pat, "initial:");
     std::getline(is, pat);
     is >> init;
-    queue_ = Tags::strToTag(init);
+    auto tag = Tags::strToTag(init);
+    queue_ = Queue{};
+    queue_.append(tag.begin(), tag.end());
     indx_ = 0U;
   }
 
   void dumpTable(std::ostream &os) const { tags_.dump(os); }
 
+  static void dumpQueue(std::ostream &os, const Queue &queue) {
+    if (queue.empty())
+      os << "-";
+    std::string str;
+    str.reserve(queue.size());
+    queue.forEach([&str](bool sym) { str.push_back(Tags::symToStr(sym)); });
+    os << str;
+  }
+
   void dumpState(std::ostream &os) const {
-    os << Tags::tagToStr(queue_) << std::endl;
+    dumpQueue(os, queue_);
+    os << std::endl;
   }
 
-  void step() {
-    if (queue_.empty()) {
+  static void step(const Tags &tags, Queue &queue, size_t &indx) {
+    if (queue.empty()) {
       auto msg = "Queue is empty";
       throw std::runtime_error(msg);
     }
-    auto head = queue_.front();
-    queue_.pop_front();
-    if (head) {
-      const auto &tag = tags_.getTag(indx_);
-      std::copy(tag.begin(), tag.end(), std::back_inserter(queue_));
+    auto head = queue.front();
+    queue.pop();
+    if (head)
+      queue.append(tags.getBits(indx));
+    indx = (indx + 1) % tags.size();
+  }
+
+  // Does the steps up to the first 1 at the front, which only move to the
+  // next production, or a single step when the front is 1. The steps stop at
+  // the end of the cycle, where halts are checked and dumps are done, and at
+  // maxSteps. Returns the number of steps done.
+  static size_t skipOrStep(const Tags &tags, Queue &queue, size_t &indx,
+                           size_t maxSteps) {
+    auto count = queue.countZeros(std::min(maxSteps, tags.size() - indx));
+    if (count == 0) {
+      step(tags, queue, indx);
+      return 1U;
     }
-    indx_ = (indx_ + 1) % tags_.size();
+    queue.pop(count);
+    indx = (indx + count) % tags.size();
+    return count;
   }
 
+  void step() { step(tags_, queue_, indx_); }
+
   bool atBegin() const { return indx_ == 0U; }
 
   bool hlt() const { return tags_.isHlt(queue_); }
 
+  // Runs on a queue that spills to disk beyond the memory cap.
+  void executeSpilled(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    read(is);
+    if (tags_.isOneHot())
+      return executeSparse(os, lvl);
+    SpillQueue<std::uint8_t> queue{spillCap_};
+    std::vector<std::uint8_t> initial;
+    queue_.forEach([&initial](bool sym) { initial.push_back(sym); });
+    queue.append(initial.begin(), initial.end());
+    queue_ = Queue{};
+    dumpTable(os);
+    BitQueue::Bits prefix;
+    prefix.words_.resize(tags_.haltSize() / BitQueue::WordBits + 1);
+    auto hlt = [&] {
+      if (queue.size() < tags_.haltSize())
+        return false;
+      std::fill(prefix.words_.begin(), prefix.words_.end(), 0U);
+      size_t pos = 0U;
+      queue.forEach(tags_.haltSize(), [&](std::uint8_t sym) {
+        prefix.words_[pos / BitQueue::WordBits] |=
+            BitQueue::Word{sym} << (pos % BitQueue::WordBits);
+        ++pos;
+      });
+      return tags_.isHlt(prefix);
+    };
+    auto dumpState = [&] {
+      if (queue.empty())
+        os << "-";
+      queue.forEach([&os](std::uint8_t sym) { os.put(Tags::symToStr(sym)); });
+      os << std::endl;
+    };
+    size_t stepsCount = 0U;
+    for (;;) {
+      auto begin = atBegin();
+      if (begin && hlt())
+        break;
+      if (lvl > 0)
+        if (begin || lvl > 1)
+          dumpState();
+      if (!unlimited_ && ++stepsCount > 10000) {
+        auto msg = "Too many steps";
+        throw std::runtime_error(msg);
+      }
+      if (queue.empty()) {
+        auto msg = "Queue is empty";
+        throw std::runtime_error(msg);
+      }
+      auto head = queue.front();
+      queue.pop(1U);
+      if (head) {
+        const auto &tag = tags_.getTag(indx_);
+        queue.append(tag.begin(), tag.end());
+      }
+      indx_ = (indx_ + 1) % tags_.size();
+    }
+    dumpState();
+    os.flush();
+  }
+
+  // Runs one-hot programs on the positions of the Y of the queue, numbered
+  // from the start of the run, the N between them being implicit: head and
+  // tail are the positions of the first bit and the one past the last. The
+  // steps over N are taken at once up to the end of the cycle, and a
+  // production appends the positions of its Y moved to the tail, so the
+  // cost goes with the Y rather than with the blocks. Positions spill like
+  // the bits of executeSpilled do.
+  void executeSparse(std::ostream &os, DumpLvl lvl) {
+    using Pos = std::uint64_t;
+    SpillQueue<Pos> ys{spillCap_ == 0 ? std::numeric_limits<size_t>::max()
+                                      : spillCap_};
+    Pos head = 0U, tail = 0U;
+    std::vector<Pos> appends;
+    queue_.forEach([&](bool sym) {
+      if (sym)
+        appends.push_back(tail);
+      ++tail;
+    });
+    ys.append(appends.begin(), appends.end());
+    queue_ = Queue{};
+    dumpTable(os);
+    Tags::PosStorage prefix;
+    prefix.reserve(tags_.maxHaltYs() + 1);
+    auto hlt = [&] {
+      if (tail - head < tags_.haltSize())
+        return false;
+      prefix.clear();
+      ys.forEach(std::min(ys.size(), tags_.maxHaltYs() + 1), [&](Pos pos) {
+        if (pos - head < tags_.haltSize())
+          prefix.push_back(pos - head);
+      });
+      return tags_.isHlt(prefix);
+    };
+    std::string str;
+    auto dumpState = [&] {
+      if (head == tail)
+        os << "-";
+      str.assign(tail - head, Tags::symToStr(false));
+      ys.forEach([&](Pos pos) { str[pos - head] = Tags::symToStr(true); });
+      os << str << std::endl;
+    };
+    size_t stepsCount = 0U;
+    for (;;) {
+      auto begin = atBegin();
+      if (begin && hlt())
+        break;
+      if (lvl > 0)
+        if (begin || lvl > 1)
+          dumpState();
+      if (head == tail) {
+        auto msg = "Queue is empty";
+        throw std::runtime_error(msg);
+      }
+      auto next = ys.empty() ? tail : ys.front();
+      size_t count = 1U;
+      if (next == head) {
+        ys.pop(1U);
+        const auto &tag = tags_.getSparse(indx_);
+        appends.clear();
+        for (auto &&y : tag.ys_)
+          appends.push_back(tail + y);
+        ys.append(appends.begin(), appends.end());
+        tail += tag.size_;
+      } else if (lvl < 2) {
+        count = std::min<size_t>(next - head, tags_.size() - indx_);
+      }
+      head += count;
+      indx_ = (indx_ + count) % tags_.size();
+      stepsCount += count;
+      if (!unlimited_ && stepsCount > 10000) {
+        auto msg = "Too many steps";
+        throw std::runtime_error(msg);
+      }
+    }
+    dumpState();
+    os.flush();
+  }
+
   friend class machines::TSConverter;
 
 public:
+  // Sweeps share the tags and give every initial word its own queue.
+  struct Config final {
+    Queue queue_;
+    size_t indx_ = 0U;
+  };
+
+  static Config readConfig(const Tags &, const std::string &initial) {
+    auto tag = Tags::strToTag(initial);
+    Config config;
+    config.queue_.append(tag.begin(), tag.end());
+    return config;
+  }
+
+  // Stops short of the steps as soon as the queue is empty.
+  static size_t run(const Tags &tags, Config &config, size_t maxSteps) {
+    size_t stepsCount = 0U;
+    while (stepsCount != maxSteps && !hlt(tags, config) &&
+           !config.queue_.empty())
+      stepsCount += skipOrStep(tags, config.queue_, config.indx_,
+                               maxSteps - stepsCount);
+    return stepsCount;
+  }
+
+  static bool hlt(const Tags &tags, const Config &config) {
+    return config.indx_ == 0U && tags.isHlt(config.queue_);
+  }
+
+  static void dumpConfig(std::ostream &os, const Tags &,
+                         const Config &config) {
+    dumpQueue(os, config.queue_);
+    os << "\n";
+  }
+
+  // Keeps at most the given number of megabytes of the queue in memory and
+  // spills the rest to a temporary file.
+  void setSpill(size_t megabytes) { spillCap_ = megabytes << 20; }
+
+  // Lifts the limit of steps for runs meant to be long.
+  void setUnlimited(bool unlimited) { unlimited_ = unlimited; }
+
   void execute(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    if (spillCap_ != 0)
+      return executeSpilled(is, os, lvl);
     read(is);
+    if (tags_.isOneHot())
+      return executeSparse(os, lvl);
     dumpTable(os);
     size_t stepsCount = 0U;
     for (;;) {
       auto begin = atBegin();
-      if (hlt() && begin)
+      if (begin && hlt())
         break;
       if (lvl > 0)
         if (begin || lvl > 1)
           dumpState(os);
-      step();
-      stepsCount++;
-      if (stepsCount > 10000) {
+      if (lvl > 1) {
+        step();
+        stepsCount++;
+      } else {
+        stepsCount += skipOrStep(tags_, queue_, indx_, tags_.size());
+      }
+      if (!unlimited_ && stepsCount > 10000) {
         auto msg = "Too many steps";
         throw std::runtime_error(msg);
       }
@@ -219,6 +681,23 @@ public:
     dumpState(os);
     os.flush();
   }
+
+  // Runs the tags on every word of the sweep over N and Y.
+  void sweep(std::istream &is, std::ostream &os, const Sweep &sweep) {
+    tags_.read(is);
+    auto toStr = [](const Sweep::Word &word) {
+      std::string str;
+      for (auto &&sym : word)
+        str.push_back(Tags::symToStr(sym));
+      return str;
+    };
+    Sweep::InitialStorage initials;
+    for (auto &&word : sweep.lengthWords(2U))
+      initials.push_back(toStr(word));
+    for (auto &&word : sweep.rangeWords(2U))
+      initials.push_back(toStr(word));
+    sweep.run<CyclicTagSystem>(tags_, initials, os);
+  }
 };
 
 } // namespace cts
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include "TagSystem.hpp"
+#include "TuringMachineConverter.hpp"
+
+namespace machines {
+
+// Runs a Turing machine at its own speed and lowers it to the tag system of
+// TMConverter only at checkpoints. The queue of a checkpoint is the one the
+// tag system has when it starts to emulate the next step of the machine,
+// built from the configuration of the machine the way the converter builds
+// the initial queue. From the last checkpoint the tag system may resume by
+// itself, dumping like ETS does.
+//
+// Every checkpoint is written as
+//
+//   step <steps>:
+//   <queue>
+//
+// a machine halting before a checkpoint being lowered at its halt.
+class LoweredTuringMachine final : public Machine<LoweredTuringMachine> {
+  using TuringMachine = tm::BasicTuringMachine<tm::Tape>;
+  using TagSystem = ts::BasicTagSystem<2U>;
+  using Tags = ts::Tags;
+  using Queue = ts::Queue;
+  using StepStorage = std::vector<size_t>;
+
+  StepStorage checkpoints_;
+  bool resume_ = false;
+  bool grouped_ = false;
+
+  void dumpQueue(std::ostream &os, const Tags &tags, const Queue &queue) const {
+    if (grouped_) {
+      ts::GroupWriter writer{os, tags};
+      queue.dump(writer);
+    } else {
+      queue.dump(os, tags);
+    }
+  }
+
+public:
+  // Steps of the machine to lower it at, the initial configuration when none
+  // are given.
+  void setCheckpoints(StepStorage checkpoints) {
+    std::sort(checkpoints.begin(), checkpoints.end());
+    checkpoints.erase(std::unique(checkpoints.begin(), checkpoints.end()),
+                      checkpoints.end());
+    checkpoints_ = std::move(checkpoints);
+  }
+
+  // Runs the tag system from the last checkpoint until it halts.
+  void setResume(bool resume) { resume_ = resume; }
+
+  // Dumps queues as groups of repeated pairs, see ts::GroupWriter.
+  void setGrouped(bool grouped) { grouped_ = grouped; }
+
+  void execute(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    auto program = TMConverter::readBinary(is);
+    std::stringstream converted;
+    TMConverter converter;
+    converter.convert(program, converted);
+    program.clear();
+    program.seekg(0);
+    TuringMachine tm;
+    tm.read(program);
+    Tags tags;
+    tags.read(converted);
+    auto checkpoints = checkpoints_.empty() ? StepStorage{0U} : checkpoints_;
+    size_t steps = 0U;
+    Queue queue;
+    for (auto &&checkpoint : checkpoints) {
+      steps += tm.run(checkpoint - steps);
+      queue = TMConverter::lowerQueue(tm, tags, steps);
+      os << "step " << steps << ":\n";
+      dumpQueue(os, tags, queue);
+      if (tm.hlt())
+        break;
+    }
+    if (resume_) {
+      TagSystem ts;
+      ts.setGrouped(grouped_);
+      ts.load(std::move(tags), std::move(queue));
+      ts.resume(os, lvl);
+    }
+    os.flush();
+  }
+};
+
+} // namespace machines
@@ -16,7 +16,7 @@ class Manager {
     auto path = std::filesystem::path(prog);
     auto name = path.filename().generic_string();
     return name == "ETM" || name == "ETS" || name == "ECTS" || name == "CTM" ||
-           name == "CTS";
+           name == "CTS" || name == "GTM" || name == "NTM";
   }
 
 public:
@@ -1,14 +1,38 @@
 #pragma once
 
+#include <array>
 #include <boost/program_options.hpp>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "Sweep.hpp"
 
 namespace machines {
 
 namespace po = boost::program_options;
 
+// Options of a particular machine, specialized next to its main().
+template <typename Machine> struct MachineOptions {
+  static void add(po::options_description &, Machine &) {}
+};
+
+// Machines having sweep(is, os, const Sweep &) run one program on many
+// initial words, and only their executors take the sweep options.
+template <typename Machine, typename = void>
+struct MachineSweeps : std::false_type {};
+
+template <typename Machine>
+struct MachineSweeps<
+    Machine, std::void_t<decltype(std::declval<Machine &>().sweep(
+                 std::declval<std::istream &>(), std::declval<std::ostream &>(),
+                 std::declval<const Sweep &>()))>> : std::true_type {};
+
 template <typename Machine> class MachineExecutor {
   using opt_desc = po::options_description;
   using vars_map = po::variables_map;
@@ -22,6 +46,8 @@ template <typename Machine> class MachineExecutor {
   bool help_ = false;
 
   std::string name_;
+  Machine machine_;
+  Sweep sweep_;
 
   void initProgramOptions() {
     opt_desc generic("Generic options");
@@ -35,7 +61,27 @@ template <typename Machine> class MachineExecutor {
         "out", po::value<std::string>()->implicit_value(""),
         outDesc.c_str())("dump", po::value<DumpLvl>()->implicit_value(1),
                          "Dump Level during execution");
+    MachineOptions<Machine>::add(config, machine_);
     cmdline_.add(generic).add(config);
+    if constexpr (MachineSweeps<Machine>::value)
+      addSweepOptions();
+  }
+
+  void addSweepOptions() {
+    opt_desc sweep("Sweep");
+    auto length = [this](size_t length) { sweep_.setMaxLength(length); };
+    auto range = [this](const std::string &range) { sweep_.setRange(range); };
+    auto steps = [this](size_t steps) { sweep_.setMaxSteps(steps); };
+    auto threads = [this](size_t threads) { sweep_.setThreads(threads); };
+    sweep.add_options()("sweep-length", po::value<size_t>()->notifier(length),
+                        "Run on every initial word of length 1 to N")(
+        "sweep-range", po::value<std::string>()->notifier(range),
+        "Run on every number A:B written in the symbols")(
+        "steps", po::value<size_t>()->notifier(steps),
+        "Steps of every sweep run, 1000000 by default")(
+        "threads", po::value<size_t>()->notifier(threads),
+        "Threads of the sweep, all cores by default");
+    cmdline_.add(sweep);
   }
 
   void parseProgramOptions(int argc, const char *argv[]) {
@@ -90,8 +136,11 @@ public:
     }
     std::ifstream is{input_};
     std::ofstream os{output_};
-    Machine ex;
-    ex.execute(is, os, dumpLvl_);
+    if constexpr (MachineSweeps<Machine>::value) {
+      if (sweep_.enabled())
+        return machine_.sweep(is, os, sweep_);
+    }
+    machine_.execute(is, os, dumpLvl_);
   }
 };
 
@@ -106,6 +155,7 @@ template <typename Converter> class MachineConverter {
   bool help_ = false;
 
   std::string name_;
+  Converter converter_;
 
   void initProgramOptions() {
     opt_desc generic("Generic options");
@@ -117,6 +167,7 @@ template <typename Converter> class MachineConverter {
     config.add_options()("in", po::value<std::string>()->required(),
                          inDesc.c_str())(
         "out", po::value<std::string>()->implicit_value(""), outDesc.c_str());
+    MachineOptions<Converter>::add(config, converter_);
     cmdline_.add(generic).add(config);
   }
 
@@ -164,8 +215,167 @@ public:
     }
     std::ifstream is{input_};
     std::ofstream os{output_};
-    Converter c;
-    c.convert(is, os);
+    converter_.convert(is, os);
+  }
+};
+
+// Runs the same program on every machine type and reports steps/sec.
+// Machines must provide read(std::istream &) and run(size_t maxSteps).
+template <typename... Machines> class MachineBenchmark {
+  using opt_desc = po::options_description;
+  using vars_map = po::variables_map;
+  using cmd_line_parser = po::command_line_parser;
+  using Names = std::array<std::string_view, sizeof...(Machines)>;
+  using Clock = std::chrono::steady_clock;
+
+  opt_desc cmdline_{"Options"};
+  std::string input_;
+  size_t maxSteps_ = 100000000U;
+  bool help_ = false;
+
+  std::string name_;
+  Names names_;
+
+  void initProgramOptions() {
+    opt_desc generic("Generic options");
+    generic.add_options()("help,h", "help message");
+
+    opt_desc config("Configuration");
+    std::string inDesc = "Input file for benchmarking " + name_;
+    config.add_options()("in", po::value<std::string>()->required(),
+                         inDesc.c_str())(
+        "steps", po::value<size_t>(), "Steps budget for every run");
+    cmdline_.add(generic).add(config);
+  }
+
+  void parseProgramOptions(int argc, const char *argv[]) {
+    vars_map vm;
+    try {
+      auto parser = cmd_line_parser(argc, argv);
+      po::store(parser.options(cmdline_).run(), vm);
+      po::notify(vm);
+
+      if (vm.count("help")) {
+        help_ = true;
+        return;
+      }
+      input_ = vm["in"].as<std::string>();
+      if (vm.count("steps"))
+        maxSteps_ = vm["steps"].as<size_t>();
+    } catch (const po::error &) {
+      if (vm.count("help")) {
+        help_ = true;
+        return;
+      }
+      throw;
+    }
+  }
+
+  template <typename Machine>
+  void measure(std::string_view name, const std::string &program) const {
+    std::istringstream is{program};
+    Machine m;
+    m.read(is);
+    auto start = Clock::now();
+    auto steps = m.run(maxSteps_);
+    std::chrono::duration<double> time = Clock::now() - start;
+    std::cout << name << "\t" << steps << " steps\t" << time.count()
+              << " s\t" << steps / time.count() << " steps/s" << std::endl;
+  }
+
+public:
+  MachineBenchmark(std::string_view name, Names names)
+      : name_(name), names_(names) {}
+
+  void run(int argc, const char *argv[]) {
+    initProgramOptions();
+    parseProgramOptions(argc, argv);
+    if (help_) {
+      std::cout << cmdline_ << std::endl;
+      return;
+    }
+    std::ifstream is{input_};
+    std::stringstream program;
+    program << is.rdbuf();
+    size_t i = 0;
+    (measure<Machines>(names_[i++], program.str()), ...);
+  }
+};
+
+// Enumerates the machines of a number of states on all cores and writes the
+// results. Enumerator must be constructible from (states, maxSteps) and provide
+// enumerate(threads, std::ostream &) and dumpSummary(std::ostream &).
+template <typename Enumerator> class MachineEnumerator {
+  using opt_desc = po::options_description;
+  using vars_map = po::variables_map;
+  using cmd_line_parser = po::command_line_parser;
+
+  opt_desc cmdline_{"Options"};
+  std::string output_;
+  unsigned states_ = 0U;
+  size_t maxSteps_ = 1000U;
+  size_t threads_ = std::thread::hardware_concurrency();
+  bool help_ = false;
+
+  std::string name_;
+
+  void initProgramOptions() {
+    opt_desc generic("Generic options");
+    generic.add_options()("help,h", "help message");
+
+    opt_desc config("Configuration");
+    std::string outDesc = "Write enumerated " + name_ + "s to output file";
+    config.add_options()("states", po::value<unsigned>()->required(),
+                         "Number of states")(
+        "steps", po::value<size_t>(), "Steps budget for every machine")(
+        "threads", po::value<size_t>(), "Number of threads")(
+        "out", po::value<std::string>(), outDesc.c_str());
+    cmdline_.add(generic).add(config);
+  }
+
+  void parseProgramOptions(int argc, const char *argv[]) {
+    vars_map vm;
+    try {
+      auto parser = cmd_line_parser(argc, argv);
+      po::store(parser.options(cmdline_).run(), vm);
+      po::notify(vm);
+
+      if (vm.count("help")) {
+        help_ = true;
+        return;
+      }
+      states_ = vm["states"].as<unsigned>();
+      if (vm.count("steps"))
+        maxSteps_ = vm["steps"].as<size_t>();
+      if (vm.count("threads"))
+        threads_ = vm["threads"].as<size_t>();
+      if (vm.count("out"))
+        output_ = vm["out"].as<std::string>();
+      else
+        output_ = "enumerated_" + std::to_string(states_) + ".txt";
+    } catch (const po::error &) {
+      if (vm.count("help")) {
+        help_ = true;
+        return;
+      }
+      throw;
+    }
+  }
+
+public:
+  MachineEnumerator(std::string_view name) : name_(name) {}
+
+  void run(int argc, const char *argv[]) {
+    initProgramOptions();
+    parseProgramOptions(argc, argv);
+    if (help_) {
+      std::cout << cmdline_ << std::endl;
+      return;
+    }
+    std::ofstream os{output_};
+    Enumerator e{states_, maxSteps_};
+    e.enumerate(threads_, os);
+    e.dumpSummary(std::cout);
   }
 };
 
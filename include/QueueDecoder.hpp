@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include "TuringMachineConverter.hpp"
+
+namespace machines {
+
+// Reads queues of the tag system TMConverter makes of a machine, and of the
+// cyclic tag system TSConverter makes of that one, back into configurations
+// of the machine. A queue is decoded where the tag system starts to emulate a
+// step, its front being a head tag: the tags read by the steps are the head
+// tag and a tag for every unit of the left and right tape numbers, so the
+// decoder counts the tags at even places of the queue. Queues come in any of
+// the notations ETS and LTM dump:
+//
+//   Ha1 Ha0 La1 La0     plain, tag by tag;
+//   (Ha1Ha0)(La1La0)[3] groups or runs of tags with their count;
+//   YNNN...NYNN         one-hot blocks of the cyclic tag system.
+//
+// A run is counted as a whole, so decoding takes time in the size of the
+// notation rather than in the tape numbers.
+class QueueDecoder final : public Machine<QueueDecoder> {
+  using States = tm::States;
+  using StateIndx = States::StateIndx;
+  using SymbolStates = tm::BasicStates<256U>;
+  using TagType = Tag::TagType;
+  using TagStorage = Tag::TagStorage;
+  using NameMap = std::unordered_map<std::string, Tag>;
+
+public:
+  // Configuration of the binary machine the tag system emulates, the tape
+  // halves being numbers the way TMConverter writes them.
+  struct Config final {
+    StateIndx stateIndx_;
+    bool head_;
+    size_t left_;
+    size_t right_;
+  };
+
+private:
+  States states_;
+  SymbolStates symbolStates_;
+  size_t width_ = 1U;
+  NameMap names_;
+  size_t maxNameSize_ = 0U;
+  std::string queuePath_;
+
+  // Head, left and right tags in this order, the digitless ones being kinds
+  // of their own.
+  static size_t kind(TagType type) { return static_cast<size_t>(type) / 3; }
+
+  static bool hasDigit(TagType type) {
+    return Tag::hasZero(type) || Tag::hasOne(type);
+  }
+
+  // Takes the longest tag name at pos.
+  const Tag *readName(std::string_view line, size_t &pos) const {
+    for (auto len = std::min(maxNameSize_, line.size() - pos); len != 0;
+         --len) {
+      auto found = names_.find(std::string{line.substr(pos, len)});
+      if (found != names_.end()) {
+        pos += len;
+        return &found->second;
+      }
+    }
+    return nullptr;
+  }
+
+  // Every block of the cyclic tag system holds a single Y at the index of
+  // its tag, tags going by states the way TMConverter writes them.
+  template <typename Visit>
+  bool readBlocks(std::string_view line, Visit visit) const {
+    auto tagsCount = states_.size() * Tag::TypesCount;
+    if (line.size() % tagsCount != 0)
+      return false;
+    TagStorage word;
+    for (size_t pos = 0; pos != line.size(); pos += tagsCount) {
+      auto block = line.substr(pos, tagsCount);
+      auto indx = block.find('Y');
+      if (indx == block.npos || block.find('Y', indx + 1) != block.npos)
+        return false;
+      word.assign(1U, Tag::get(static_cast<StateIndx>(indx / Tag::TypesCount),
+                               static_cast<TagType>(indx % Tag::TypesCount)));
+      if (!visit(word, 1U))
+        return false;
+    }
+    return true;
+  }
+
+  // Calls visit(TagStorage, size_t) for every run of the queue with its
+  // count, a tag standing alone being a run of its own.
+  template <typename Visit>
+  bool readRuns(std::string_view line, Visit visit) const {
+    if (!line.empty() && line.find_first_not_of("YN") == line.npos)
+      return readBlocks(line, visit);
+    TagStorage word;
+    size_t pos = 0U;
+    while (pos != line.size()) {
+      if (line[pos] == ' ') {
+        ++pos;
+        continue;
+      }
+      word.clear();
+      if (line[pos] == '(') {
+        auto close = line.find(')', pos++);
+        if (close == line.npos)
+          return false;
+        while (pos != close) {
+          const auto *tag = readName(line.substr(0, close), pos);
+          if (!tag)
+            return false;
+          word.push_back(*tag);
+        }
+        ++pos;
+      } else {
+        const auto *tag = readName(line, pos);
+        if (!tag)
+          return false;
+        word.push_back(*tag);
+      }
+      size_t count = 1U;
+      if (pos != line.size() && line[pos] == '[') {
+        auto close = line.find(']', pos);
+        if (close == line.npos)
+          return false;
+        auto last = line.data() + close;
+        auto res = std::from_chars(line.data() + pos + 1, last, count);
+        if (res.ec != std::errc{} || res.ptr != last)
+          return false;
+        pos = close + 1;
+      }
+      if (word.empty() || count == 0 || !visit(word, count))
+        return false;
+    }
+    return true;
+  }
+
+  bool isSymbolState(const std::string &name) const {
+    return std::any_of(symbolStates_.begin(), symbolStates_.end(),
+                       [&](auto &&state) { return state.name_ == name; });
+  }
+
+  // Bits go in blocks of the binary encoding, the highest bit first.
+  void appendSymbols(std::string &str, const std::string &bits) const {
+    for (size_t pos = 0; pos != bits.size(); pos += width_) {
+      auto sym = std::stoul(bits.substr(pos, width_), nullptr, 2);
+      if (sym >= symbolStates_.getAlphabet().size()) {
+        auto msg = "Bits " + bits.substr(pos, width_) + " are no symbol";
+        throw std::runtime_error(msg);
+      }
+      str.push_back(symbolStates_.symToStr(static_cast<std::uint8_t>(sym)));
+    }
+  }
+
+public:
+  // Reads the program of the machine, which TMConverter makes binary when it
+  // is over more than two symbols.
+  void read(std::istream &is) {
+    std::stringstream program;
+    program << is.rdbuf();
+    auto symbols = tm::Alphabet::peek(program).size();
+    program.clear();
+    program.seekg(0);
+    if (symbols > 2U) {
+      symbolStates_.read(program);
+      program.clear();
+      program.seekg(0);
+      while ((size_t{1} << width_) < symbols)
+        ++width_;
+    }
+    auto binary = TMConverter::readBinary(program);
+    states_.read(binary);
+    utils::EnumRange<TagType> range{TagType::Hk0, TagType::Rkk};
+    for (auto &&state : states_) {
+      for (auto &&tagType : range) {
+        auto tag = Tag::get(state.indx_, tagType);
+        auto name = tag.toString(states_);
+        maxNameSize_ = std::max(maxNameSize_, name.size());
+        names_.emplace(std::move(name), tag);
+      }
+    }
+  }
+
+  // Decodes a queue whose front is a head tag. Returns false for lines that
+  // are no such queue, as the table dumps of ETS and ECTS, the step lines of
+  // LTM and the queues in the middle of a step are.
+  bool decode(std::string_view line, Config &config) const {
+    std::array<size_t, 3> counts{};
+    size_t lastKind = 0U;
+    size_t odd = 0U;
+    auto first = true;
+    auto visit = [&](const TagStorage &word, size_t count) {
+      if (first) {
+        auto type = word.front().type_;
+        if (type != TagType::Hk0 && type != TagType::Hk1)
+          return false;
+        config.stateIndx_ = word.front().stateIndx_;
+        config.head_ = type == TagType::Hk1;
+        first = false;
+      }
+      for (size_t i = 0; i != word.size(); ++i) {
+        const auto &tag = word[i];
+        if (tag.stateIndx_ != config.stateIndx_ || !hasDigit(tag.type_) ||
+            kind(tag.type_) < lastKind)
+          return false;
+        lastKind = kind(tag.type_);
+        auto parity = (odd + i) & 1U;
+        // Repeats of a word of odd length switch places every time.
+        auto even = count / 2 + (parity ? 0U : count % 2);
+        if (word.size() % 2 == 0)
+          even = parity ? 0U : count;
+        auto &sum = counts[lastKind];
+        if (__builtin_add_overflow(sum, even, &sum)) {
+          auto msg = "Tape numbers of the queue are too large";
+          throw std::runtime_error(msg);
+        }
+      }
+      if (count != 1 && kind(word.front().type_) != lastKind)
+        return false;
+      odd ^= word.size() & count & 1U;
+      return true;
+    };
+    if (!readRuns(line, visit) || first || counts[0] != 1)
+      return false;
+    if (config.head_ != (odd == 0))
+      return false;
+    config.left_ = counts[1];
+    config.right_ = counts[2];
+    return true;
+  }
+
+  // Writes the configuration the way the machine dumps its tape, 110[a]111,
+  // without blanks beyond the tape numbers. Machines over more than two
+  // symbols are written in their symbols at the states of their own, and as
+  // the binary machine in the middle of a step.
+  std::string toString(const Config &config) const {
+    std::string left, right;
+    for (auto num = config.left_; num != 0; num >>= 1)
+      left.push_back(num & 1U ? '1' : '0');
+    std::reverse(left.begin(), left.end());
+    for (auto num = config.right_; num != 0; num >>= 1)
+      right.push_back(num & 1U ? '1' : '0');
+    const auto &name = states_.getState(config.stateIndx_).name_;
+    std::string str;
+    if (width_ == 1U || !isSymbolState(name)) {
+      for (auto &&bit : left)
+        str.push_back(states_.symToStr(bit == '1'));
+      str.push_back(states_.symToStr(config.head_));
+      str += "[" + name + "]";
+      for (auto &&bit : right)
+        str.push_back(states_.symToStr(bit == '1'));
+      return str;
+    }
+    left.insert(0, (width_ - left.size() % width_) % width_, '0');
+    auto head = std::string(1, config.head_ ? '1' : '0');
+    head += right.substr(0, width_ - 1);
+    right.erase(0, width_ - 1);
+    head.append(width_ - head.size(), '0');
+    right.append((width_ - right.size() % width_) % width_, '0');
+    appendSymbols(str, left);
+    appendSymbols(str, head);
+    str += "[" + name + "]";
+    appendSymbols(str, right);
+    return str;
+  }
+
+  // File of the queues to decode, a dump of ETS, ECTS or LTM does.
+  void setQueuePath(std::string path) { queuePath_ = std::move(path); }
+
+  void execute(std::istream &is, std::ostream &os, DumpLvl) {
+    if (queuePath_.empty()) {
+      auto msg = "No queues to decode, give them with --queue";
+      throw std::runtime_error(msg);
+    }
+    std::ifstream queues{queuePath_};
+    if (!queues) {
+      auto msg = "Can't open queues '" + queuePath_ + "'";
+      throw std::runtime_error(msg);
+    }
+    read(is);
+    std::string line;
+    Config config;
+    while (std::getline(queues, line))
+      if (decode(line, config))
+        os << toString(config) << "\n";
+    os.flush();
+  }
+};
+
+} // namespace machines
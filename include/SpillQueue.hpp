@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <iterator>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace machines {
+
+// Queue of fixed-size segments that keeps at most memoryCap bytes of them in
+// memory. The segment under the head and the one at the tail stay in memory;
+// once the cap is reached, every segment the tail fills is written to a
+// temporary file instead, those being read last. A spilled segment is mapped
+// back when the head comes to the segment before it, so its pages are read
+// ahead of the head. Slots of consumed segments are reused.
+template <typename T> class SpillQueue final {
+  static constexpr size_t SegmentBytes = size_t{1} << 22;
+  static constexpr size_t SegmentSize = SegmentBytes / sizeof(T);
+
+  struct Segment final {
+    std::vector<T> data_;
+    size_t size_ = 0U;
+    bool spilled_ = false;
+    size_t slot_ = 0U;
+    void *map_ = nullptr;
+  };
+
+  using SegmentQueue = std::deque<Segment>;
+  using SlotStorage = std::vector<size_t>;
+
+  SegmentQueue segments_;
+  size_t memorySegments_;
+  size_t inMemory_ = 0U;
+  size_t first_ = 0U;
+  size_t size_ = 0U;
+  std::FILE *file_ = nullptr;
+  size_t slots_ = 0U;
+  SlotStorage freeSlots_;
+
+  static const T *data(const Segment &segment) noexcept {
+    return segment.spilled_ ? static_cast<const T *>(segment.map_)
+                            : segment.data_.data();
+  }
+
+  void *map(size_t slot) const {
+    auto *map = mmap(nullptr, SegmentBytes, PROT_READ, MAP_SHARED,
+                     fileno(file_), slot * SegmentBytes);
+    if (map == MAP_FAILED) {
+      auto msg = "Can't map a spilled queue segment";
+      throw std::runtime_error(msg);
+    }
+    return map;
+  }
+
+  void load(Segment &segment) {
+    if (!segment.spilled_ || segment.map_)
+      return;
+    segment.map_ = map(segment.slot_);
+    madvise(segment.map_, SegmentBytes, MADV_WILLNEED);
+  }
+
+  void spill(Segment &segment) {
+    if (!file_ && !(file_ = std::tmpfile())) {
+      auto msg = "Can't create a file to spill the queue";
+      throw std::runtime_error(msg);
+    }
+    if (freeSlots_.empty())
+      freeSlots_.push_back(slots_++);
+    segment.slot_ = freeSlots_.back();
+    freeSlots_.pop_back();
+    const auto *bytes = reinterpret_cast<const char *>(segment.data_.data());
+    size_t written = 0U;
+    while (written != SegmentBytes) {
+      auto res = pwrite(fileno(file_), bytes + written, SegmentBytes - written,
+                        segment.slot_ * SegmentBytes + written);
+      if (res <= 0) {
+        auto msg = "Can't spill a queue segment";
+        throw std::runtime_error(msg);
+      }
+      written += res;
+    }
+    segment.data_ = std::vector<T>{};
+    segment.spilled_ = true;
+    --inMemory_;
+  }
+
+  void release(Segment &segment) {
+    if (segment.map_)
+      munmap(segment.map_, SegmentBytes);
+    if (segment.spilled_)
+      freeSlots_.push_back(segment.slot_);
+    else
+      --inMemory_;
+  }
+
+  void pushSegment() {
+    segments_.emplace_back();
+    segments_.back().data_.reserve(SegmentSize);
+    ++inMemory_;
+  }
+
+  // Drops consumed segments in front of the head and reads the next one
+  // ahead.
+  void advance() {
+    while (segments_.size() > 1 && first_ >= segments_.front().size_) {
+      first_ -= segments_.front().size_;
+      release(segments_.front());
+      segments_.pop_front();
+      load(segments_.front());
+      if (segments_.size() > 1)
+        load(segments_[1]);
+    }
+  }
+
+public:
+  explicit SpillQueue(size_t memoryCap)
+      : memorySegments_(std::max<size_t>(memoryCap / SegmentBytes, 2U)) {
+    pushSegment();
+  }
+
+  SpillQueue(const SpillQueue &) = delete;
+  SpillQueue &operator=(const SpillQueue &) = delete;
+
+  ~SpillQueue() {
+    for (auto &&segment : segments_)
+      if (segment.map_)
+        munmap(segment.map_, SegmentBytes);
+    if (file_)
+      std::fclose(file_);
+  }
+
+  bool empty() const noexcept { return size_ == 0; }
+
+  size_t size() const noexcept { return size_; }
+
+  T front() const noexcept { return data(segments_.front())[first_]; }
+
+  void pop(size_t count) {
+    first_ += count;
+    size_ -= count;
+    advance();
+  }
+
+  template <typename Iter> void append(Iter first, Iter last) {
+    while (first != last) {
+      auto *tail = &segments_.back();
+      if (tail->size_ == SegmentSize) {
+        if (inMemory_ >= memorySegments_ && segments_.size() > 1)
+          spill(*tail);
+        pushSegment();
+        tail = &segments_.back();
+      }
+      auto count = std::min<size_t>(SegmentSize - tail->size_,
+                                    std::distance(first, last));
+      auto next = std::next(first, count);
+      tail->data_.insert(tail->data_.end(), first, next);
+      tail->size_ += count;
+      size_ += count;
+      first = next;
+    }
+    advance();
+  }
+
+  // Calls visit(T) for the first count elements, mapping spilled segments
+  // for the time of the visit.
+  template <typename Visit> void forEach(size_t count, Visit visit) const {
+    auto pos = first_;
+    for (auto &&segment : segments_) {
+      if (count == 0)
+        break;
+      auto *mapped =
+          segment.spilled_ && !segment.map_ ? map(segment.slot_) : nullptr;
+      const auto *elems =
+          mapped ? static_cast<const T *>(mapped) : data(segment);
+      for (; pos < segment.size_ && count != 0; ++pos, --count)
+        visit(elems[pos]);
+      pos = 0U;
+      if (mapped)
+        munmap(mapped, SegmentBytes);
+    }
+  }
+
+  template <typename Visit> void forEach(Visit visit) const {
+    forEach(size_, visit);
+  }
+};
+
+} // namespace machines
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "TuringMachine.hpp"
+
+namespace machines {
+
+namespace tm {
+
+// Machines known at build time. The table is parsed from the usual
+// states:/halt:/table: text by a constexpr parser and passed to
+// StaticTuringMachine as a template argument, which specializes the step
+// loop for every state:
+//
+//   static constexpr auto table = tm::parseStaticTable<3>(text);
+//   constexpr auto tape = [] {
+//     auto tape = tm::parseStaticTape<64>(text, table);
+//     tm::StaticTuringMachine<table>::run(tape);
+//     return tape;
+//   }();
+//   static_assert(tape.getCurStateIndx() == table.haltIndx_);
+
+// Jump of a machine known at build time, laid out as States::Jump.
+struct StaticJump final {
+  using Move = States::Move;
+  using Symbol = States::Symbol;
+  using StateIndx = States::StateIndx;
+
+  Move move_;
+  Symbol newSym_;
+  StateIndx newStateIndx_;
+};
+
+template <size_t StatesCount> struct StaticTable final {
+  using StateIndx = States::StateIndx;
+  using Jumps = std::array<StaticJump, 2U>;
+
+  std::array<std::string_view, StatesCount> names_;
+  std::array<Jumps, StatesCount> jumps_;
+  StateIndx haltIndx_;
+
+  constexpr StateIndx getStateIndx(std::string_view stateName) const {
+    for (StateIndx indx = 0; indx != StatesCount; ++indx)
+      if (names_[indx] == stateName)
+        return indx;
+    throw std::runtime_error("Can not find state");
+  }
+
+  constexpr bool isHlt(StateIndx indx) const noexcept {
+    return indx == haltIndx_;
+  }
+
+  static constexpr size_t size() noexcept { return StatesCount; }
+};
+
+// Whitespace separated words of a program text.
+class StaticTokens final {
+  std::string_view text_;
+
+  static constexpr bool isSpace(char sym) noexcept {
+    return sym == ' ' || sym == '\t' || sym == '\n' || sym == '\r';
+  }
+
+public:
+  constexpr explicit StaticTokens(std::string_view text) : text_(text) {}
+
+  constexpr bool empty() noexcept {
+    while (!text_.empty() && isSpace(text_.front()))
+      text_.remove_prefix(1);
+    return text_.empty();
+  }
+
+  constexpr std::string_view next() {
+    if (empty())
+      throw std::runtime_error("Unexpected end of program");
+    size_t len = 0;
+    while (len != text_.size() && !isSpace(text_[len]))
+      ++len;
+    auto token = text_.substr(0, len);
+    text_.remove_prefix(len);
+    return token;
+  }
+
+  constexpr void expect(std::string_view pattern) {
+    if (next() != pattern)
+      throw std::runtime_error("Unexpected section");
+  }
+
+  constexpr void skipTo(std::string_view pattern) {
+    while (next() != pattern) {
+    }
+  }
+
+  static constexpr States::Symbol toSym(char sym) {
+    if (sym != '0' && sym != '1')
+      throw std::runtime_error("Unknown symbol");
+    return sym == '1';
+  }
+
+  static constexpr char toStr(States::Symbol sym) noexcept {
+    return sym ? '1' : '0';
+  }
+};
+
+template <size_t StatesCount>
+constexpr StaticTable<StatesCount> parseStaticTable(std::string_view text) {
+  StaticTable<StatesCount> table{};
+  StaticTokens tokens{text};
+  tokens.expect("states:");
+  for (auto &&name : table.names_)
+    name = tokens.next();
+  tokens.expect("halt:");
+  table.haltIndx_ = table.getStateIndx(tokens.next());
+  tokens.expect("table:");
+  for (size_t i = 0; i != 2 * (StatesCount - 1); ++i) {
+    auto stateIndx = table.getStateIndx(tokens.next());
+    auto sym = tokens.next();
+    auto newSym = tokens.next();
+    auto newStateIndx = table.getStateIndx(tokens.next());
+    auto move = tokens.next();
+    if (sym.size() != 1 || newSym.size() != 1 || move.size() != 1)
+      throw std::runtime_error("Wrong jump");
+    auto &jump = table.jumps_[stateIndx][StaticTokens::toSym(sym.front())];
+    jump.move_ = move == "L" ? States::Move::L : States::Move::R;
+    if (move != "L" && move != "R")
+      throw std::runtime_error("Unknown move");
+    jump.newSym_ = StaticTokens::toSym(newSym.front());
+    jump.newStateIndx_ = newStateIndx;
+  }
+  return table;
+}
+
+// Tape of Cells cells that can be run inside constant expressions. Moves and
+// bound trimming follow DequeTape; running off the array throws.
+template <size_t Cells> class StaticTape final {
+  using Symbol = States::Symbol;
+  using StateIndx = States::StateIndx;
+
+  std::array<Symbol, Cells> cells_{};
+  size_t head_ = 0;
+  size_t lo_ = 0;
+  size_t hi_ = 0;
+  StateIndx curStateIndx_ = 0;
+
+  constexpr size_t toNumber(size_t from, size_t to) const noexcept {
+    size_t num = 0;
+    for (; from != to; ++from)
+      num = (num << 1) | cells_[from];
+    return num;
+  }
+
+public:
+  template <size_t StatesCount>
+  constexpr void read(std::string_view text,
+                      const StaticTable<StatesCount> &table) {
+    StaticTokens tokens{text};
+    tokens.skipTo("initial:");
+    auto tapeStr = tokens.next();
+    auto leftBound = tapeStr.find('[');
+    auto rightBound = tapeStr.find(']');
+    if (leftBound == 0 || leftBound == tapeStr.npos || rightBound < leftBound)
+      throw std::runtime_error("Wrong tape");
+    auto size = tapeStr.size() - (rightBound - leftBound + 1);
+    if (size + 2 > Cells)
+      throw std::length_error("Static tape is too short");
+    lo_ = (Cells - size) / 2;
+    head_ = lo_ + leftBound - 1;
+    hi_ = lo_ + size - 1;
+    auto pos = lo_;
+    for (size_t i = 0; i != tapeStr.size(); ++i)
+      if (i < leftBound || i > rightBound)
+        cells_[pos++] = StaticTokens::toSym(tapeStr[i]);
+    auto stateName = tapeStr.substr(leftBound + 1, rightBound - leftBound - 1);
+    curStateIndx_ = table.getStateIndx(stateName);
+  }
+
+  template <size_t StatesCount>
+  void dump(std::ostream &os, const StaticTable<StatesCount> &table) const {
+    for (auto pos = lo_; pos <= head_; ++pos)
+      os << StaticTokens::toStr(cells_[pos]);
+    os << '[' << table.names_[curStateIndx_] << ']';
+    for (auto pos = head_ + 1; pos <= hi_; ++pos)
+      os << StaticTokens::toStr(cells_[pos]);
+    os << "\n";
+  }
+
+  constexpr void moveLeft(Symbol newSym) {
+    if (head_ == 0)
+      throw std::length_error("Static tape is too short");
+    cells_[head_--] = newSym;
+    if (!cells_[hi_])
+      --hi_;
+    lo_ = std::min(lo_, head_);
+  }
+
+  constexpr void moveRight(Symbol newSym) {
+    if (head_ + 1 == Cells)
+      throw std::length_error("Static tape is too short");
+    cells_[head_++] = newSym;
+    if (!cells_[lo_])
+      ++lo_;
+    hi_ = std::max(hi_, head_);
+  }
+
+  // Tape halves as numbers, the cell next to the head being the lowest digit.
+  constexpr size_t leftNumber() const noexcept { return toNumber(lo_, head_); }
+
+  constexpr size_t rightNumber() const noexcept {
+    size_t num = 0;
+    for (auto pos = hi_; pos != head_; --pos)
+      num = (num << 1) | cells_[pos];
+    return num;
+  }
+
+  constexpr void setCurStateIndx(StateIndx curStateIndx) noexcept {
+    curStateIndx_ = curStateIndx;
+  }
+
+  constexpr StateIndx getCurStateIndx() const noexcept { return curStateIndx_; }
+
+  constexpr Symbol getHead() const noexcept { return cells_[head_]; }
+};
+
+template <size_t Cells, size_t StatesCount>
+constexpr StaticTape<Cells>
+parseStaticTape(std::string_view text, const StaticTable<StatesCount> &table) {
+  StaticTape<Cells> tape;
+  tape.read(text, table);
+  return tape;
+}
+
+// Step loop specialized for one table. Works on any tape with the interface
+// of the runtime tapes, and in constant expressions on StaticTape.
+template <const auto &Table> class StaticTuringMachine final {
+  using StateIndx = States::StateIndx;
+  using Symbol = States::Symbol;
+
+  static constexpr auto StatesCount = Table.size();
+
+  template <typename TapeT>
+  static constexpr void jump(TapeT &tape, const StaticJump &jump) {
+    if (jump.move_ == States::Move::L)
+      tape.moveLeft(jump.newSym_);
+    else
+      tape.moveRight(jump.newSym_);
+    tape.setCurStateIndx(jump.newStateIndx_);
+  }
+
+  template <StateIndx Indx, typename TapeT>
+  static constexpr bool step(TapeT &tape) {
+    if (tape.getCurStateIndx() != Indx)
+      return false;
+    constexpr auto &jumps = Table.jumps_[Indx];
+    if (tape.getHead())
+      jump(tape, jumps[1]);
+    else
+      jump(tape, jumps[0]);
+    return true;
+  }
+
+  template <typename TapeT, StateIndx... Indx>
+  static constexpr void step(TapeT &tape,
+                             std::integer_sequence<StateIndx, Indx...>) {
+    (step<Indx>(tape) || ...);
+  }
+
+public:
+  // Steps until halt or until maxSteps steps are made, returns steps made.
+  template <typename TapeT>
+  static constexpr size_t
+  run(TapeT &tape, size_t maxSteps = std::numeric_limits<size_t>::max()) {
+    using Indices = std::make_integer_sequence<StateIndx, StatesCount>;
+    size_t stepsCount = 0U;
+    for (; stepsCount != maxSteps && !Table.isHlt(tape.getCurStateIndx());
+         ++stepsCount)
+      step(tape, Indices{});
+    return stepsCount;
+  }
+};
+
+} // namespace tm
+
+} // namespace machines
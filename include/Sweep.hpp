@@ -0,0 +1,129 @@
+#pragma once
+
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace machines {
+
+// Runs one program on many initial configurations at once. The program is
+// read once and its table is shared read-only by all threads; every
+// configuration gets its own tape or queue.
+//
+// Configurations are words over the symbols of the machine: all words of
+// length 1 to maxLength_, then the numbers of [rangeFrom_, rangeTo_] written
+// in base of the symbols count, the highest digit first. A machine turns a
+// word into its "initial:" section.
+//
+// Every configuration gives one line of the output table:
+//
+//   <initial> <TAB> <steps> <TAB> halt|limit|stop <TAB> <final configuration>
+//
+// limit meaning the steps budget ran out and stop that the machine can not
+// step any further without halting.
+class Sweep final {
+public:
+  using Word = std::vector<size_t>;
+  using WordStorage = std::vector<Word>;
+  using InitialStorage = std::vector<std::string>;
+
+private:
+  size_t maxLength_ = 0U;
+  size_t rangeFrom_ = 0U;
+  size_t rangeTo_ = 0U;
+  bool hasRange_ = false;
+  size_t maxSteps_ = 1000000U;
+  size_t threads_ = std::thread::hardware_concurrency();
+
+public:
+  bool enabled() const noexcept { return maxLength_ != 0 || hasRange_; }
+
+  void setMaxLength(size_t maxLength) { maxLength_ = maxLength; }
+
+  // Parses "from:to".
+  void setRange(std::string_view range) {
+    auto colon = range.find(':');
+    std::istringstream from{std::string(range.substr(0, colon))};
+    std::istringstream to{std::string(range.substr(colon + 1))};
+    if (colon == range.npos || !(from >> rangeFrom_) || !(to >> rangeTo_) ||
+        rangeFrom_ > rangeTo_) {
+      auto msg = "Wrong range '" + std::string(range) + "'";
+      throw std::runtime_error(msg);
+    }
+    hasRange_ = true;
+  }
+
+  void setMaxSteps(size_t maxSteps) { maxSteps_ = maxSteps; }
+
+  void setThreads(size_t threads) { threads_ = threads; }
+
+  // All words of length 1 to maxLength_.
+  WordStorage lengthWords(size_t symbols) const {
+    WordStorage words;
+    for (size_t length = 1; length <= maxLength_; ++length) {
+      Word word(length, 0U);
+      for (;;) {
+        words.push_back(word);
+        auto digit = length;
+        while (digit != 0 && ++word[digit - 1] == symbols)
+          word[--digit] = 0U;
+        if (digit == 0)
+          break;
+      }
+    }
+    return words;
+  }
+
+  // The numbers of the range, the highest digit first.
+  WordStorage rangeWords(size_t symbols) const {
+    WordStorage words;
+    if (!hasRange_)
+      return words;
+    for (auto num = rangeFrom_;; ++num) {
+      Word word;
+      auto rest = num;
+      do {
+        word.insert(word.begin(), rest % symbols);
+        rest /= symbols;
+      } while (rest != 0);
+      words.push_back(std::move(word));
+      if (num == rangeTo_)
+        break;
+    }
+    return words;
+  }
+
+  // Runs every initial configuration and writes the table in their order.
+  // Engine provides Config, readConfig(table, initial), run(table, config,
+  // maxSteps), hlt(table, config) and dumpConfig(os, table, config).
+  template <typename Engine, typename Table>
+  void run(const Table &table, const InitialStorage &initials,
+           std::ostream &os) const {
+    using Pool = WorkStealingPool<size_t>;
+    InitialStorage lines(initials.size());
+    std::vector<size_t> tasks(initials.size());
+    std::iota(tasks.begin(), tasks.end(), size_t{0});
+    Pool pool{threads_};
+    pool.run(std::move(tasks), [&](size_t indx, Pool::Worker &) {
+      auto config = Engine::readConfig(table, initials[indx]);
+      auto steps = Engine::run(table, config, maxSteps_);
+      std::ostringstream line;
+      line << initials[indx] << "\t" << steps << "\t";
+      if (Engine::hlt(table, config))
+        line << "halt\t";
+      else
+        line << (steps == maxSteps_ ? "limit\t" : "stop\t");
+      Engine::dumpConfig(line, table, config);
+      lines[indx] = line.str();
+    });
+    for (auto &&line : lines)
+      os << line;
+    os.flush();
+  }
+};
+
+} // namespace machines
@@ -1,11 +1,25 @@
 #pragma once
 
 #include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <deque>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
 #include <vector>
 
 #include "AbstractMachine.hpp"
+#include "SpillQueue.hpp"
+#include "Sweep.hpp"
+#include "ThreadPool.hpp"
 #include "Utils.hpp"
 
 namespace machines {
@@ -29,9 +43,12 @@ public:
   using TagStorage = std::vector<Tag>;
   using TagConstIter = TagStorage::const_iterator;
 
+  static constexpr unsigned DefaultDeletion = 2U;
+
 private:
   TagStorage tags_;
   TagIndxStorage halts_;
+  unsigned deletion_ = DefaultDeletion;
 
   TagIndx getTagIndx(std::string_view tagName) const {
     auto found = std::find_if(tags_.begin(), tags_.end(),
@@ -43,9 +60,18 @@ private:
     return found->indx_;
   }
 
-  void readTags(std::istream &is) {
-    std::string pat, tagName;
-    is >> pat;
+  // Reads the number after the "m:" header.
+  static unsigned readDeletion(std::istream &is) {
+    unsigned deletion = 0U;
+    if (!(is >> deletion) || deletion == 0) {
+      auto msg = "Deletion number must be a positive integer";
+      throw std::runtime_error(msg);
+    }
+    return deletion;
+  }
+
+  void readTags(std::istream &is, std::string pat) {
+    std::string tagName;
     utils::checkPattern(pat, "tags:");
     std::getline(is, pat);
     auto iss = utils::readLineToSS(is);
@@ -85,6 +111,12 @@ private:
     }
   }
 
+  void dumpDeletion(std::ostream &os) const {
+    if (deletion_ == DefaultDeletion)
+      return;
+    os << "m:\n" << deletion_ << "\n\n";
+  }
+
   void dumpTags(std::ostream &os) const {
     os << "tags:\n";
     for (auto &&tag : tags_)
@@ -113,12 +145,31 @@ private:
   }
 
 public:
+  // The "m:" section giving the number of tags a step deletes is optional
+  // and defaults to 2.
   void read(std::istream &is) {
-    readTags(is);
+    std::string pat;
+    is >> pat;
+    deletion_ = DefaultDeletion;
+    if (pat == "m:") {
+      deletion_ = readDeletion(is);
+      is >> pat;
+    }
+    readTags(is, pat);
     readHalt(is);
     readTable(is);
   }
 
+  // Deletion number of a program text, which is read up to its "tags:"
+  // header.
+  static unsigned peekDeletion(std::istream &is) {
+    std::string pat;
+    is >> pat;
+    return pat == "m:" ? readDeletion(is) : DefaultDeletion;
+  }
+
+  unsigned getDeletion() const noexcept { return deletion_; }
+
   const Tag &getTag(TagIndx indx) const { return tags_.at(indx); }
 
   const Tag &getTag(std::string_view tagName) const {
@@ -130,6 +181,7 @@ public:
   }
 
   void dump(std::ostream &os) const {
+    dumpDeletion(os);
     dumpTags(os);
     dumpHalt(os);
     dumpTable(os);
@@ -148,15 +200,223 @@ public:
   TagConstIter end() const noexcept { return tags_.end(); }
 };
 
+// Tags compiled for running: the appends of all tags in one array with
+// offsets, and bitsets of halt tags and head tags, a head tag being named
+// H...0 or H...1. Refers to the tags it was built from for their names.
+class Program final {
+public:
+  using TagIndx = Tags::TagIndx;
+  using Offset = std::uint32_t;
+
+private:
+  using OffsetStorage = std::vector<Offset>;
+  using TagIndxStorage = Tags::TagIndxStorage;
+  using Bits = std::uint64_t;
+  using BitStorage = std::vector<Bits>;
+
+  static constexpr unsigned BitsShift = 6U;
+  static constexpr TagIndx BitsMask = 63U;
+
+  const Tags &tags_;
+  OffsetStorage offsets_;
+  TagIndxStorage appends_;
+  BitStorage halts_;
+  BitStorage heads_;
+  size_t maxAppendSize_ = 0U;
+  unsigned deletion_;
+
+  static bool test(const BitStorage &bits, TagIndx indx) noexcept {
+    return bits[indx >> BitsShift] >> (indx & BitsMask) & 1U;
+  }
+
+  static void set(BitStorage &bits, TagIndx indx) noexcept {
+    bits[indx >> BitsShift] |= Bits{1} << (indx & BitsMask);
+  }
+
+  static bool isHeadName(const std::string &name) {
+    auto fir = *name.begin(), last = *std::prev(name.end());
+    return fir == 'H' && (last == '0' || last == '1');
+  }
+
+public:
+  explicit Program(const Tags &tags)
+      : tags_(tags), halts_((tags.size() >> BitsShift) + 1),
+        heads_((tags.size() >> BitsShift) + 1),
+        deletion_(tags.getDeletion()) {
+    offsets_.reserve(tags.size() + 1);
+    offsets_.push_back(0U);
+    for (auto &&tag : tags) {
+      appends_.insert(appends_.end(), tag.append_.begin(), tag.append_.end());
+      if (appends_.size() > std::numeric_limits<Offset>::max()) {
+        auto msg = "Too many appends for the program";
+        throw std::runtime_error(msg);
+      }
+      offsets_.push_back(static_cast<Offset>(appends_.size()));
+      maxAppendSize_ = std::max(maxAppendSize_, tag.append_.size());
+      if (isHeadName(tag.name_))
+        set(heads_, tag.indx_);
+    }
+    for (auto halt = tags.haltBegin(); halt != tags.haltEnd(); ++halt)
+      set(halts_, *halt);
+  }
+
+  const Tags &getTags() const noexcept { return tags_; }
+
+  const TagIndx *appendBegin(TagIndx indx) const noexcept {
+    return appends_.data() + offsets_[indx];
+  }
+
+  const TagIndx *appendEnd(TagIndx indx) const noexcept {
+    return appends_.data() + offsets_[indx + 1];
+  }
+
+  size_t appendSize(TagIndx indx) const noexcept {
+    return offsets_[indx + 1] - offsets_[indx];
+  }
+
+  size_t maxAppendSize() const noexcept { return maxAppendSize_; }
+
+  unsigned getDeletion() const noexcept { return deletion_; }
+
+  bool isHlt(TagIndx indx) const noexcept { return test(halts_, indx); }
+
+  bool isHead(TagIndx indx) const noexcept { return test(heads_, indx); }
+};
+
+// Writes a queue tag by tag, every name followed by a space.
+class TagWriter final {
+  using TagIndx = Tags::TagIndx;
+
+  std::ostream &os_;
+  const Tags &tags_;
+
+public:
+  TagWriter(std::ostream &os, const Tags &tags) : os_(os), tags_(tags) {}
+
+  void write(TagIndx tagIndx) {
+    const auto &name = tags_.getTag(tagIndx).name_;
+    os_.write(name.data(), name.size()).put(' ');
+  }
+
+  void finish() { os_.put('\n'); }
+};
+
+// Writes a queue as groups of m tags, m being the deletion number, repeated
+// groups written with their count: (Hb1Hb0)(Rb1Rb0)[15], the last tags that
+// don't fill a group being written alone. Groups are found while streaming,
+// so a dump of tape halves in unary takes space logarithmic in them.
+class GroupWriter final {
+  using TagIndx = Tags::TagIndx;
+  using TagIndxStorage = Tags::TagIndxStorage;
+
+  std::ostream &os_;
+  const Tags &tags_;
+  TagIndxStorage word_;
+  TagIndxStorage group_;
+  size_t count_ = 0U;
+
+  void writeName(TagIndx tagIndx) {
+    const auto &name = tags_.getTag(tagIndx).name_;
+    os_.write(name.data(), name.size());
+  }
+
+  void flush() {
+    if (count_ == 0)
+      return;
+    os_.put('(');
+    for (auto &&tagIndx : group_)
+      writeName(tagIndx);
+    os_.put(')');
+    if (count_ != 1)
+      os_ << '[' << count_ << ']';
+    count_ = 0U;
+  }
+
+public:
+  GroupWriter(std::ostream &os, const Tags &tags) : os_(os), tags_(tags) {
+    word_.reserve(tags.getDeletion());
+  }
+
+  void write(TagIndx tagIndx) {
+    word_.push_back(tagIndx);
+    if (word_.size() != tags_.getDeletion())
+      return;
+    if (count_ != 0 && group_ == word_) {
+      ++count_;
+    } else {
+      flush();
+      group_.swap(word_);
+      count_ = 1U;
+    }
+    word_.clear();
+  }
+
+  void finish() {
+    flush();
+    for (auto &&tagIndx : word_)
+      writeName(tagIndx);
+    word_.clear();
+    os_.put('\n');
+  }
+};
+
+// Ring buffer over a power of two cells, so positions wrap with a mask.
+// Popping tags only moves the first position and a production is copied
+// right behind the last one. Productions being a few tags long, a masked
+// loop copies them faster than memcpy does. A full buffer doubles and is
+// unrolled to start at the first cell.
 class Queue final {
   using TagIndx = Tags::TagIndx;
-  using TagQueue = std::deque<TagIndx>;
+  using TagQueue = std::vector<TagIndx>;
+
+  static constexpr size_t MinCapacity = 16U;
 
-  TagQueue queue_;
+  TagQueue queue_ = TagQueue(MinCapacity);
+  size_t first_ = 0U;
+  size_t size_ = 0U;
+
+  size_t mask() const noexcept { return queue_.size() - 1; }
+
+  void grow(size_t size) {
+    auto capacity = queue_.size();
+    while (capacity < size)
+      capacity *= 2;
+    TagQueue queue(capacity);
+    auto tail = std::min(size_, queue_.size() - first_);
+    std::memcpy(queue.data(), queue_.data() + first_, tail * sizeof(TagIndx));
+    std::memcpy(queue.data() + tail, queue_.data(),
+                (size_ - tail) * sizeof(TagIndx));
+    queue_ = std::move(queue);
+    first_ = 0U;
+  }
 
 public:
-  using TagQueueConstIter = TagQueue::const_iterator;
-  using BackInsertIter = std::back_insert_iterator<TagQueue>;
+  class ConstIter final {
+    const Queue *queue_;
+    size_t pos_;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = TagIndx;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const TagIndx *;
+    using reference = const TagIndx &;
+
+    ConstIter(const Queue *queue, size_t pos) : queue_(queue), pos_(pos) {}
+
+    reference operator*() const {
+      return queue_->queue_[(queue_->first_ + pos_) & queue_->mask()];
+    }
+
+    ConstIter &operator++() {
+      ++pos_;
+      return *this;
+    }
+
+    bool operator==(const ConstIter &rhs) const { return pos_ == rhs.pos_; }
+
+    bool operator!=(const ConstIter &rhs) const { return pos_ != rhs.pos_; }
+  };
 
   void read(std::istream &is, const Tags &tags) {
     std::string pat, tagName;
@@ -164,84 +424,739 @@ public:
     utils::checkPattern(pat, "initial:");
     std::getline(is, pat);
     auto iss = utils::readLineToSS(is);
-    while (iss >> tagName)
-      queue_.emplace_back(tags.getTag(tagName).indx_);
+    while (iss >> tagName) {
+      auto tagIndx = tags.getTag(tagName).indx_;
+      append(&tagIndx, 1U);
+    }
+  }
+
+  template <typename Writer> void dump(Writer &writer) const {
+    for (auto &&tagIndx : *this)
+      writer.write(tagIndx);
+    writer.finish();
+  }
+
+  void dump(std::ostream &os, const Tags &tags) const {
+    TagWriter writer{os, tags};
+    dump(writer);
+  }
+
+  bool empty() const noexcept { return size_ == 0; }
+
+  size_t size() const noexcept { return size_; }
+
+  void popTags(size_t count) noexcept {
+    first_ = (first_ + count) & mask();
+    size_ -= count;
+  }
+
+  TagIndx frontTagIndx() const noexcept { return queue_[first_]; }
+
+  void append(const TagIndx *tags, size_t count) {
+    if (size_ + count > queue_.size())
+      grow(size_ + count);
+    auto *data = queue_.data();
+    auto last = (first_ + size_) & mask();
+    size_ += count;
+    for (size_t i = 0; i != count; ++i)
+      data[(last + i) & mask()] = tags[i];
+  }
+
+  ConstIter begin() const noexcept { return ConstIter{this, 0U}; }
+
+  ConstIter end() const noexcept { return ConstIter{this, size_}; }
+};
+
+// Queue of runs, a run being a word repeated count times, so a queue whose
+// tags repeat in long runs takes little memory. Appended words are cut to
+// their shortest period and merged into the last run when they repeat it.
+class RunLengthQueue final {
+  using TagIndx = Tags::TagIndx;
+  using TagIndxStorage = Tags::TagIndxStorage;
+
+public:
+  struct Run final {
+    TagIndxStorage word_;
+    size_t count_;
+  };
+
+private:
+  using RunQueue = std::deque<Run>;
+
+  static constexpr size_t MaxPeriod = 16U;
+
+  RunQueue runs_;
+
+  static size_t mul(size_t lhs, size_t rhs) {
+    size_t res;
+    if (__builtin_mul_overflow(lhs, rhs, &res)) {
+      auto msg = "Run is too long";
+      throw std::runtime_error(msg);
+    }
+    return res;
   }
 
+  // Length of the shortest word the given one repeats.
+  static size_t period(const TagIndxStorage &word) {
+    for (size_t len = 1; len < word.size(); ++len) {
+      if (word.size() % len != 0)
+        continue;
+      if (std::equal(word.begin() + len, word.end(), word.begin()))
+        return len;
+    }
+    return word.size();
+  }
+
+public:
+  using RunQueueConstIter = RunQueue::const_iterator;
+
+  // Reads the initial queue cutting it into runs greedily: the period up to
+  // MaxPeriod that covers the most tags from the current one wins.
+  void read(std::istream &is, const Tags &tags) {
+    Queue queue;
+    queue.read(is, tags);
+    TagIndxStorage initial{queue.begin(), queue.end()};
+    for (size_t first = 0; first != initial.size();) {
+      size_t bestPeriod = 1U, bestCount = 1U;
+      for (size_t len = 1; len <= MaxPeriod; ++len) {
+        size_t count = 1U;
+        while (first + (count + 1) * len <= initial.size() &&
+               std::equal(initial.begin() + first + count * len,
+                          initial.begin() + first + (count + 1) * len,
+                          initial.begin() + first))
+          ++count;
+        if (count > 1 && count * len > bestCount * bestPeriod)
+          bestPeriod = len, bestCount = count;
+      }
+      auto begin = initial.begin() + first;
+      append(TagIndxStorage{begin, begin + bestPeriod}, bestCount);
+      first += bestPeriod * bestCount;
+    }
+  }
+
+  // Writes runs as (word)[count], leaving out a count of 1 and the
+  // brackets of a single tag.
   void dump(std::ostream &os, const Tags &tags) const {
-    for (auto &&tagIndx : queue_)
-      os << tags.getTag(tagIndx).name_ << " ";
+    for (auto &&run : runs_) {
+      auto group = run.word_.size() != 1 || run.count_ != 1;
+      if (group)
+        os << "(";
+      for (auto &&tagIndx : run.word_)
+        os << tags.getTag(tagIndx).name_;
+      if (group)
+        os << ")";
+      if (run.count_ != 1)
+        os << "[" << run.count_ << "]";
+    }
     os << "\n";
   }
 
-  bool empty() const noexcept { return queue_.empty(); }
+  bool empty() const noexcept { return runs_.empty(); }
+
+  const Run &front() const noexcept { return runs_.front(); }
+
+  TagIndx frontTagIndx() const noexcept { return runs_.front().word_.front(); }
+
+  void popFront() { runs_.pop_front(); }
+
+  void append(TagIndxStorage word, size_t count) {
+    if (word.empty() || count == 0)
+      return;
+    auto len = period(word);
+    if (len != word.size()) {
+      count = mul(count, word.size() / len);
+      word.resize(len);
+    }
+    if (!runs_.empty() && runs_.back().word_ == word) {
+      auto &last = runs_.back().count_;
+      if (__builtin_add_overflow(last, count, &last)) {
+        auto msg = "Run is too long";
+        throw std::runtime_error(msg);
+      }
+      return;
+    }
+    runs_.push_back(Run{std::move(word), count});
+  }
+
+  // Pops one tag: w^c without its first tag is (w_1..w_n w_0)^(c-1) w_1..w_n.
+  void popTag() {
+    if (runs_.empty()) {
+      auto msg = "Queue is empty";
+      throw std::runtime_error(msg);
+    }
+    auto &run = runs_.front();
+    TagIndxStorage rest{run.word_.begin() + 1, run.word_.end()};
+    if (run.count_ == 1) {
+      if (rest.empty())
+        runs_.pop_front();
+      else
+        run.word_ = std::move(rest);
+      return;
+    }
+    std::rotate(run.word_.begin(), run.word_.begin() + 1, run.word_.end());
+    --run.count_;
+    if (!rest.empty())
+      runs_.insert(runs_.begin() + 1, Run{std::move(rest), 1U});
+  }
 
-  void popTwoTags() noexcept {
-    queue_.pop_front();
-    queue_.pop_front();
+  // Makes the word length of the first run a multiple of m unless the run is
+  // shorter than the word that has: w^c becomes (w^k)^(c/k) and w^(c%k), k
+  // being the fewest words making a multiple of m.
+  void alignFront(size_t m) {
+    auto &run = runs_.front();
+    auto k = m / std::gcd(run.word_.size(), m);
+    if (k == 1 || run.count_ < k)
+      return;
+    auto word = run.word_;
+    auto rest = run.count_ % k;
+    for (size_t i = 1; i != k; ++i)
+      run.word_.insert(run.word_.end(), word.begin(), word.end());
+    run.count_ /= k;
+    if (rest != 0)
+      runs_.insert(runs_.begin() + 1, Run{std::move(word), rest});
   }
 
-  TagIndx frontTagIndx() const noexcept { return queue_.front(); }
+  RunQueueConstIter begin() const noexcept { return runs_.begin(); }
 
-  BackInsertIter backInserter() { return std::back_inserter(queue_); }
+  RunQueueConstIter end() const noexcept { return runs_.end(); }
+};
 
-  TagQueueConstIter begin() const noexcept { return queue_.begin(); }
+// Queue for running in passes: one pass reads every m-th tag of the
+// current generation and writes their appends into the next one, which
+// then becomes current. Buffers are left uninitialized, a pass writing
+// over the whole next buffer anyway.
+class PassQueue final {
+  using TagIndx = Tags::TagIndx;
+  using Buffer = std::unique_ptr<TagIndx[]>;
+
+  Buffer cur_;
+  Buffer next_;
+  size_t curCapacity_ = 0U;
+  size_t nextCapacity_ = 0U;
+  size_t size_ = 0U;
+  size_t first_ = 0U;
+
+public:
+  void read(std::istream &is, const Tags &tags) {
+    Queue queue;
+    queue.read(is, tags);
+    size_ = curCapacity_ = queue.size();
+    cur_ = Buffer{new TagIndx[size_]};
+    std::copy(queue.begin(), queue.end(), cur_.get());
+    first_ = 0U;
+  }
+
+  // Tags left of the current generation, then the ones written so far.
+  template <typename Writer>
+  void dump(Writer &writer, size_t pos, const TagIndx *last) const {
+    for (auto *tag = cur_.get() + pos; tag != cur_.get() + size_; ++tag)
+      writer.write(*tag);
+    for (auto *tag = next_.get(); tag != last; ++tag)
+      writer.write(*tag);
+    writer.finish();
+  }
 
-  TagQueueConstIter end() const noexcept { return queue_.end(); }
+  const TagIndx *cur() const noexcept { return cur_.get(); }
+
+  size_t size() const noexcept { return size_; }
+
+  size_t first() const noexcept { return first_; }
+
+  // Makes room for the next generation of at most size tags.
+  TagIndx *next(size_t size) {
+    if (nextCapacity_ < size) {
+      next_ = Buffer{new TagIndx[size]};
+      nextCapacity_ = size;
+    }
+    return next_.get();
+  }
+
+  // Makes the next generation current, its first tag being skipped when the
+  // last step of the pass popped it.
+  void swap(const TagIndx *last, size_t first) {
+    std::swap(cur_, next_);
+    std::swap(curCapacity_, nextCapacity_);
+    size_ = last - cur_.get();
+    first_ = first;
+  }
 };
 
-class TagSystem final : public machines::Machine<TagSystem> {
+// Tag system deleting m tags a step. A nonzero Deletion fixes m at compile
+// time, so the strides of the common systems fold into constants, and a zero
+// one takes m from the program.
+template <unsigned Deletion>
+class BasicTagSystem final
+    : public machines::Machine<BasicTagSystem<Deletion>> {
   using TagIndx = Tags::TagIndx;
+  using TagIndxStorage = Tags::TagIndxStorage;
+
+public:
+  using DumpLvl = typename machines::Machine<BasicTagSystem>::DumpLvl;
+
+private:
+  static constexpr size_t MinParallelTags = 1U << 16;
 
   Tags tags_;
   Queue queue_;
+  bool runLength_ = false;
+  bool passes_ = false;
+  size_t threads_ = 1U;
+  bool grouped_ = false;
+  size_t spillCap_ = 0U;
 
-  void read(std::istream &is) {
+  static size_t deletion(const Program &program) noexcept {
+    if constexpr (Deletion != 0U)
+      return Deletion;
+    else
+      return program.getDeletion();
+  }
+
+  void checkDeletion() const {
+    if (Deletion != 0U && tags_.getDeletion() != Deletion) {
+      auto msg = "Program deletes " + std::to_string(tags_.getDeletion()) +
+                 " tags a step, not " + std::to_string(Deletion);
+      throw std::runtime_error(msg);
+    }
+  }
+
+  void readTags(std::istream &is) {
     tags_.read(is);
+    checkDeletion();
+  }
+
+  void read(std::istream &is) {
+    readTags(is);
     queue_.read(is, tags_);
   }
 
   void dumpTable(std::ostream &os) const { tags_.dump(os); }
 
-  void dumpState(std::ostream &os) const { queue_.dump(os, tags_); }
+  template <typename Writer, typename DumpQueue, typename... Args>
+  static void dumpQueue(Writer &writer, const DumpQueue &queue, Args... args) {
+    queue.dump(writer, args...);
+  }
 
-  void step() {
-    if (queue_.empty()) {
+  template <typename Writer>
+  static void dumpQueue(Writer &writer, const SpillQueue<TagIndx> &queue) {
+    queue.forEach([&writer](TagIndx tagIndx) { writer.write(tagIndx); });
+    writer.finish();
+  }
+
+  template <typename DumpQueue, typename... Args>
+  void dumpState(std::ostream &os, const DumpQueue &queue,
+                 Args... args) const {
+    if (grouped_) {
+      GroupWriter writer{os, tags_};
+      dumpQueue(writer, queue, args...);
+    } else {
+      TagWriter writer{os, tags_};
+      dumpQueue(writer, queue, args...);
+    }
+  }
+
+  static void step(const Program &program, Queue &queue) {
+    if (queue.empty()) {
       auto msg = "Queue is empty";
       throw std::runtime_error(msg);
     }
-    const auto &tag = tags_.getTag(queue_.frontTagIndx());
-    const auto &append = tag.append_;
-    std::copy(append.begin(), append.end(), queue_.backInserter());
-    queue_.popTwoTags();
+    auto front = queue.frontTagIndx();
+    auto size = program.appendSize(front);
+    if (queue.size() + size < deletion(program)) {
+      auto msg = "Queue is shorter than the tags a step deletes";
+      throw std::runtime_error(msg);
+    }
+    queue.append(program.appendBegin(front), size);
+    queue.popTags(deletion(program));
   }
 
-  bool onHead() const {
-    const auto &head = tags_.getTag(queue_.frontTagIndx());
-    const auto &headName = head.name_;
-    auto fir = *headName.begin(), last = *std::prev(headName.end());
-    return fir == 'H' && (last == '0' || last == '1');
+  // Tags batches of steps must stop on, as plain steps do: halt tags and
+  // dumped head tags.
+  static bool isStop(const Program &program, TagIndx tagIndx, DumpLvl lvl) {
+    return program.isHlt(tagIndx) || (lvl > 0 && program.isHead(tagIndx));
+  }
+
+  // Deletes a whole run (w)^c with the length of w a multiple of m in one
+  // go. Its steps read every m-th tag of w c times, so the queue gets the
+  // appends of those tags repeated c times. Stop tags are read one step at a
+  // time, and so are runs that can't be aligned to m. Returns the number of
+  // steps done.
+  static size_t stepRun(const Program &program, RunLengthQueue &queue,
+                        DumpLvl lvl) {
+    auto m = deletion(program);
+    queue.alignFront(m);
+    const auto &run = queue.front();
+    const auto &word = run.word_;
+    auto batch = word.size() % m == 0;
+    for (size_t j = 0; batch && j < word.size(); j += m)
+      batch = !isStop(program, word[j], lvl) || (j == 0 && run.count_ == 1);
+    if (!batch) {
+      auto front = queue.frontTagIndx();
+      auto begin = program.appendBegin(front);
+      queue.append(TagIndxStorage{begin, program.appendEnd(front)}, 1U);
+      for (size_t j = 0; j != m; ++j)
+        queue.popTag();
+      return 1U;
+    }
+    TagIndxStorage appends;
+    for (size_t j = 0; j < word.size(); j += m)
+      appends.insert(appends.end(), program.appendBegin(word[j]),
+                     program.appendEnd(word[j]));
+    auto count = run.count_;
+    auto steps = word.size() / m * count;
+    if (steps / count != word.size() / m) {
+      auto msg = "Too many steps";
+      throw std::runtime_error(msg);
+    }
+    queue.popFront();
+    queue.append(std::move(appends), count);
+    return steps;
+  }
+
+  void executeRunLength(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    readTags(is);
+    RunLengthQueue queue;
+    queue.read(is, tags_);
+    Program program{tags_};
+    dumpTable(os);
+    for (;;) {
+      if (queue.empty()) {
+        auto msg = "Queue is empty";
+        throw std::runtime_error(msg);
+      }
+      auto front = queue.frontTagIndx();
+      if (program.isHlt(front))
+        break;
+      if (lvl > 0)
+        if (program.isHead(front) || lvl > 1)
+          queue.dump(os, tags_);
+      stepRun(program, queue, lvl);
+    }
+    queue.dump(os, tags_);
+    os.flush();
+  }
+
+  // Writes the appends of the reads from pos up to the first stop tag on
+  // all threads and returns the position of that tag, or the end of the
+  // pass. Every thread takes a chunk of reads: it first finds the stop tag of
+  // its chunk and sums the sizes of the appends before it, then an exclusive
+  // prefix sum of those sizes up to the first chunk with a stop tag gives
+  // every thread where to write.
+  size_t scatter(const Program &program, const TagIndx *cur, size_t pos,
+                 size_t size, TagIndx *&last, DumpLvl lvl) const {
+    using SizeStorage = std::vector<size_t>;
+    auto m = deletion(program);
+    auto reads = (size - pos + m - 1) / m;
+    auto chunkFirst = [&](size_t chunk) {
+      return pos + m * (reads * chunk / threads_);
+    };
+    SizeStorage stops(threads_), sizes(threads_);
+    parallelFor(threads_, [&](size_t chunk) {
+      auto read = chunkFirst(chunk), end = chunkFirst(chunk + 1);
+      size_t appends = 0U;
+      for (; read < end && !isStop(program, cur[read], lvl); read += m)
+        appends += program.appendSize(cur[read]);
+      stops[chunk] = read;
+      sizes[chunk] = appends;
+    });
+    size_t chunks = 1U;
+    while (chunks != threads_ && stops[chunks - 1] == chunkFirst(chunks))
+      ++chunks;
+    SizeStorage offsets(chunks + 1, 0U);
+    for (size_t chunk = 0; chunk != chunks; ++chunk)
+      offsets[chunk + 1] = offsets[chunk] + sizes[chunk];
+    parallelFor(chunks, [&](size_t chunk) {
+      auto *out = last + offsets[chunk];
+      for (auto read = chunkFirst(chunk); read != stops[chunk]; read += m)
+        for (auto *append = program.appendBegin(cur[read]),
+                  *end = program.appendEnd(cur[read]);
+             append != end; ++append)
+          *out++ = *append;
+    });
+    last += offsets[chunks];
+    return stops[chunks - 1];
   }
 
-  bool hlt() const { return tags_.isHlt(queue_.frontTagIndx()); }
+  // Runs in passes over generations of the queue, so every pass streams
+  // through one buffer and writes another. Dumps are the ones of plain steps.
+  // Long stretches of a pass run on all threads unless every step dumps.
+  void executePasses(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    readTags(is);
+    PassQueue queue;
+    queue.read(is, tags_);
+    Program program{tags_};
+    auto m = deletion(program);
+    dumpTable(os);
+    for (;;) {
+      const auto *cur = queue.cur();
+      auto size = queue.size();
+      auto pos = queue.first();
+      if (pos >= size) {
+        auto msg = "Queue is empty";
+        throw std::runtime_error(msg);
+      }
+      auto reads = (size - pos + m - 1) / m;
+      auto *last = queue.next(reads * program.maxAppendSize());
+      auto parallel = threads_ > 1 && lvl < 2;
+      for (; pos < size; pos += m) {
+        if (parallel && size - pos >= MinParallelTags) {
+          pos = scatter(program, cur, pos, size, last, lvl);
+          if (pos >= size)
+            break;
+        }
+        auto tag = cur[pos];
+        if (program.isHlt(tag)) {
+          dumpState(os, queue, pos, last);
+          os.flush();
+          return;
+        }
+        if (lvl > 0)
+          if (program.isHead(tag) || lvl > 1)
+            dumpState(os, queue, pos, last);
+        for (auto *append = program.appendBegin(tag),
+                  *end = program.appendEnd(tag);
+             append != end; ++append)
+          *last++ = *append;
+      }
+      queue.swap(last, pos - size);
+    }
+  }
+
+  // Reads the initial queue tag by tag straight into the spilling queue, so
+  // neither its line nor its tags have to fit in memory.
+  void readSpilled(std::istream &is, SpillQueue<TagIndx> &queue) const {
+    static constexpr size_t BatchSize = 1U << 16;
+    std::unordered_map<std::string, TagIndx> indices;
+    for (auto &&tag : tags_)
+      indices.emplace(tag.name_, tag.indx_);
+    std::string pat, tagName;
+    is >> pat;
+    utils::checkPattern(pat, "initial:");
+    std::getline(is, pat);
+    TagIndxStorage batch;
+    for (auto sym = is.peek(); sym != EOF && sym != '\n'; sym = is.peek()) {
+      if (std::isspace(sym)) {
+        is.get();
+        continue;
+      }
+      is >> tagName;
+      auto found = indices.find(tagName);
+      if (found == indices.end()) {
+        auto msg = "Can't find tag '" + tagName + "'";
+        throw std::runtime_error(msg);
+      }
+      batch.push_back(found->second);
+      if (batch.size() == BatchSize) {
+        queue.append(batch.begin(), batch.end());
+        batch.clear();
+      }
+    }
+    queue.append(batch.begin(), batch.end());
+  }
+
+  // Runs plain steps on a queue that spills to disk beyond the memory cap.
+  void executeSpilled(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    readTags(is);
+    SpillQueue<TagIndx> queue{spillCap_};
+    readSpilled(is, queue);
+    Program program{tags_};
+    dumpTable(os);
+    for (;;) {
+      if (queue.empty()) {
+        auto msg = "Queue is empty";
+        throw std::runtime_error(msg);
+      }
+      auto front = queue.front();
+      if (program.isHlt(front))
+        break;
+      if (lvl > 0)
+        if (program.isHead(front) || lvl > 1)
+          dumpState(os, queue);
+      if (queue.size() + program.appendSize(front) < deletion(program)) {
+        auto msg = "Queue is shorter than the tags a step deletes";
+        throw std::runtime_error(msg);
+      }
+      queue.append(program.appendBegin(front), program.appendEnd(front));
+      queue.pop(deletion(program));
+    }
+    dumpState(os, queue);
+    os.flush();
+  }
 
   friend class machines::TSConverter;
 
 public:
+  // Sweeps share the program and give every initial word its own queue.
+  using Config = Queue;
+
+  static Config readConfig(const Program &program,
+                           const std::string &initial) {
+    std::istringstream is{"initial:\n" + initial + "\n"};
+    Queue queue;
+    queue.read(is, program.getTags());
+    return queue;
+  }
+
+  // Stops short of the steps as soon as a step can't pop m tags.
+  static size_t run(const Program &program, Queue &queue, size_t maxSteps) {
+    size_t stepsCount = 0U;
+    for (; stepsCount != maxSteps && canStep(program, queue); ++stepsCount)
+      step(program, queue);
+    return stepsCount;
+  }
+
+  static bool canStep(const Program &program, const Queue &queue) {
+    if (queue.empty() || hlt(program, queue))
+      return false;
+    return queue.size() + program.appendSize(queue.frontTagIndx()) >=
+           deletion(program);
+  }
+
+  static bool hlt(const Program &program, const Queue &queue) {
+    return !queue.empty() && program.isHlt(queue.frontTagIndx());
+  }
+
+  static void dumpConfig(std::ostream &os, const Program &program,
+                         const Queue &queue) {
+    queue.dump(os, program.getTags());
+  }
+
+  // Keeps the queue as runs of repeated words and deletes whole runs at once.
+  // Dumps go in the run notation and --dump 2 dumps every run deleted.
+  void setRunLength(bool runLength) { runLength_ = runLength; }
+
+  // Keeps at most the given number of megabytes of the queue in memory and
+  // spills the rest to a temporary file.
+  void setSpill(size_t megabytes) { spillCap_ = megabytes << 20; }
+
+  // Dumps the queue as groups of repeated m tags, see GroupWriter.
+  void setGrouped(bool grouped) { grouped_ = grouped; }
+
+  // Runs generation by generation instead of step by step. Passes only turn
+  // on, so a switch left off doesn't undo setPassThreads.
+  void setPasses(bool passes) { passes_ = passes_ || passes; }
+
+  // Runs long stretches of passes on the given number of threads.
+  void setPassThreads(size_t threads) {
+    threads_ = std::max<size_t>(threads, 1U);
+    passes_ = true;
+  }
+
   void execute(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    if (runLength_)
+      return executeRunLength(is, os, lvl);
+    if (passes_)
+      return executePasses(is, os, lvl);
+    if (spillCap_ != 0)
+      return executeSpilled(is, os, lvl);
     read(is);
     dumpTable(os);
+    resume(os, lvl);
+  }
+
+  // Sets up a system built in memory.
+  void load(Tags tags, Queue queue) {
+    tags_ = std::move(tags);
+    checkDeletion();
+    queue_ = std::move(queue);
+  }
+
+  // Runs the system set up so far in plain steps until a halt tag, dumping
+  // as execute does.
+  void resume(std::ostream &os, DumpLvl lvl) {
+    Program program{tags_};
     for (;;) {
-      if (hlt())
+      auto front = queue_.frontTagIndx();
+      if (program.isHlt(front))
         break;
       if (lvl > 0)
-        if (onHead() || lvl > 1)
-          dumpState(os);
-      step();
+        if (program.isHead(front) || lvl > 1)
+          dumpState(os, queue_);
+      step(program, queue_);
     }
-    dumpState(os);
+    dumpState(os, queue_);
     os.flush();
   }
+
+  // Runs the tags on every word of the sweep, the words being over all tags.
+  void sweep(std::istream &is, std::ostream &os, const Sweep &sweep) {
+    readTags(is);
+    auto toStr = [this](const Sweep::Word &word) {
+      std::string str;
+      for (auto &&tagIndx : word)
+        str.append(tags_.getTag(tagIndx).name_).push_back(' ');
+      return str;
+    };
+    Sweep::InitialStorage initials;
+    for (auto &&word : sweep.lengthWords(tags_.size()))
+      initials.push_back(toStr(word));
+    for (auto &&word : sweep.rangeWords(tags_.size()))
+      initials.push_back(toStr(word));
+    sweep.run<BasicTagSystem>(Program{tags_}, initials, os);
+  }
+};
+
+// Runs a program on the engine of its deletion number, a compile-time one
+// for the common numbers.
+class TagSystem final : public machines::Machine<TagSystem> {
+  bool runLength_ = false;
+  bool passes_ = false;
+  // Given with --parallel only, as giving it turns passes on.
+  std::optional<size_t> threads_;
+  bool grouped_ = false;
+  size_t spill_ = 0U;
+
+  template <unsigned Deletion, typename Action>
+  void dispatchDeletion(std::istream &is, Action &action) {
+    BasicTagSystem<Deletion> ts;
+    ts.setRunLength(runLength_);
+    if (threads_)
+      ts.setPassThreads(*threads_);
+    ts.setPasses(passes_);
+    ts.setGrouped(grouped_);
+    ts.setSpill(spill_);
+    action(ts, is);
+  }
+
+  // Calls action(ts, program) with the engine of the deletion number of the
+  // program.
+  template <typename Action> void dispatch(std::istream &is, Action action) {
+    std::stringstream program;
+    program << is.rdbuf();
+    auto deletion = Tags::peekDeletion(program);
+    program.clear();
+    program.seekg(0);
+    switch (deletion) {
+    case 2U:
+      return dispatchDeletion<2U>(program, action);
+    case 3U:
+      return dispatchDeletion<3U>(program, action);
+    default:
+      return dispatchDeletion<0U>(program, action);
+    }
+  }
+
+public:
+  void setRunLength(bool runLength) { runLength_ = runLength; }
+
+  void setSpill(size_t megabytes) { spill_ = megabytes; }
+
+  void setGrouped(bool grouped) { grouped_ = grouped; }
+
+  void setPasses(bool passes) { passes_ = passes_ || passes; }
+
+  void setPassThreads(size_t threads) { threads_ = threads; }
+
+  void execute(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    dispatch(is, [&](auto &ts, std::istream &program) {
+      ts.execute(program, os, lvl);
+    });
+  }
+
+  void sweep(std::istream &is, std::ostream &os, const Sweep &sweep) {
+    dispatch(is, [&](auto &ts, std::istream &program) {
+      ts.sweep(program, os, sweep);
+    });
+  }
 };
 
 } // namespace ts
@@ -1,14 +1,35 @@
 #pragma once
 
+#include <limits>
+#include <map>
+#include <numeric>
+
 #include "TagSystem.hpp"
 
 namespace machines {
 
-class TSConverter final : public Converter<TSConverter, ts::TagSystem> {
-  using TagSystem = ts::TagSystem;
+// Writes a tag system as a cyclic tag system, every tag being a block of Ns
+// with a single Y at the index of the tag. A block of several Ys would append
+// the productions of all of them one after another, so blocks are at least as
+// wide as there are tags appending different things. The compact encoding
+// gives the blocks to classes of tags that act the same: tags the initial
+// queue never comes to are dropped, and tags are merged when they halt alike
+// and append tags of the same classes.
+class TSConverter final
+    : public Converter<TSConverter, ts::BasicTagSystem<0U>> {
+  using TagSystem = ts::BasicTagSystem<0U>;
   using Tags = ts::Tags;
   using Queue = ts::Queue;
   using TagIndx = Tags::TagIndx;
+  using TagIndxStorage = Tags::TagIndxStorage;
+  using ClassKey = std::pair<TagIndx, TagIndxStorage>;
+
+  static constexpr TagIndx NoBlock = std::numeric_limits<TagIndx>::max();
+
+  bool compact_ = false;
+  // Block of every tag and the number of blocks.
+  TagIndxStorage blocks_;
+  size_t blocksCount_ = 0U;
 
   std::string tagToString(TagIndx val, size_t tagsCount) const {
     std::string str(tagsCount, 'N');
@@ -16,21 +37,85 @@ class TSConverter final : public Converter<TSConverter, ts::TagSystem> {
     return str;
   }
 
+  std::string blockToString(TagIndx tagIndx) const {
+    return tagToString(blocks_.at(tagIndx), blocksCount_);
+  }
+
+  // Marks the tags of the initial queue, the halting ones and all they
+  // append.
+  void markReachable(const TagSystem &ts) {
+    auto &&tags = ts.tags_;
+    TagIndxStorage pending(ts.queue_.begin(), ts.queue_.end());
+    pending.insert(pending.end(), tags.haltBegin(), tags.haltEnd());
+    while (!pending.empty()) {
+      auto tagIndx = pending.back();
+      pending.pop_back();
+      if (blocks_.at(tagIndx) != NoBlock)
+        continue;
+      blocks_.at(tagIndx) = tags.isHlt(tagIndx);
+      auto &&append = tags.getTag(tagIndx).append_;
+      pending.insert(pending.end(), append.begin(), append.end());
+    }
+  }
+
+  // Splits the classes of halting and other tags by the classes of the tags
+  // they append until no class splits. Classes are numbered by their first
+  // tag.
+  void mergeTags(const TagSystem &ts) {
+    auto &&tags = ts.tags_;
+    blocks_.assign(tags.size(), NoBlock);
+    markReachable(ts);
+    blocksCount_ = 0U;
+    for (;;) {
+      std::map<ClassKey, TagIndx> classes;
+      TagIndxStorage refined(tags.size(), NoBlock);
+      for (auto &&tag : tags) {
+        if (blocks_.at(tag.indx_) == NoBlock)
+          continue;
+        ClassKey key{blocks_.at(tag.indx_), {}};
+        for (auto &&append : tag.append_)
+          key.second.push_back(blocks_.at(append));
+        auto next = static_cast<TagIndx>(classes.size());
+        refined.at(tag.indx_) = classes.emplace(key, next).first->second;
+      }
+      blocks_ = std::move(refined);
+      if (classes.size() == blocksCount_)
+        break;
+      blocksCount_ = classes.size();
+    }
+  }
+
+  void setBlocks(const TagSystem &ts) {
+    if (compact_)
+      return mergeTags(ts);
+    blocksCount_ = ts.tags_.size();
+    blocks_.resize(blocksCount_);
+    std::iota(blocks_.begin(), blocks_.end(), TagIndx{0});
+  }
+
+  // A tag of an m-tag system reads one block of blocksCount_ productions and
+  // skips the m - 1 blocks of the tags it deletes.
   void writeTable(const TagSystem &ts, std::ostream &os) const {
     auto &&tags = ts.tags_;
-    auto tagsCount = tags.size();
-    os << "table:\n";
+    TagIndxStorage firsts(blocksCount_, NoBlock);
     for (auto &&tag : tags) {
+      auto block = blocks_.at(tag.indx_);
+      if (block != NoBlock && firsts.at(block) == NoBlock)
+        firsts.at(block) = tag.indx_;
+    }
+    os << "table:\n";
+    for (auto &&first : firsts) {
+      auto &&tag = tags.getTag(first);
       if (tag.append_.empty()) {
         os << "- ";
       } else {
         for (auto &&append : tag.append_) {
-          os << tagToString(append, tagsCount);
+          os << blockToString(append);
         }
       }
       os << " ";
     }
-    for (size_t i = 0; i != tagsCount; ++i) {
+    for (size_t i = 0; i != (tags.getDeletion() - 1) * blocksCount_; ++i) {
       os << "- ";
     }
     os << "\n\n";
@@ -38,28 +123,34 @@ class TSConverter final : public Converter<TSConverter, ts::TagSystem> {
 
   void writeHalt(const TagSystem &ts, std::ostream &os) const {
     auto &&tags = ts.tags_;
-    auto tagsCount = tags.size();
+    TagIndxStorage halts;
+    for (auto halt = tags.haltBegin(); halt != tags.haltEnd(); ++halt)
+      halts.push_back(blocks_.at(*halt));
+    std::sort(halts.begin(), halts.end());
+    halts.erase(std::unique(halts.begin(), halts.end()), halts.end());
     os << "halt:\n";
-    for (auto halt = tags.haltBegin(); halt != tags.haltEnd(); ++halt) {
-      os << tagToString(*halt, tagsCount) << " ";
+    for (auto &&halt : halts) {
+      os << tagToString(halt, blocksCount_) << " ";
     }
     os << "\n\n";
   }
 
   void writeInitial(const TagSystem &ts, std::ostream &os) const {
     auto &&queue = ts.queue_;
-    auto &&tags = ts.tags_;
-    auto tagsCount = tags.size();
     os << "initial:\n";
     for (auto &&tag : queue)
-      os << tagToString(tag, tagsCount);
+      os << blockToString(tag);
     os << "\n";
   }
 
 public:
+  // Writes the compact encoding, see above.
+  void setCompact(bool compact) { compact_ = compact; }
+
   void convert(std::istream &is, std::ostream &os) {
     TagSystem ts;
     ts.read(is);
+    setBlocks(ts);
     writeTable(ts, os);
     writeHalt(ts, os);
     writeInitial(ts, os);
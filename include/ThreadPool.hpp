@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace machines {
+
+// Runs tasks that spawn more tasks on a fixed number of threads. A thread
+// takes its own newest task first and steals the oldest task of another
+// thread when it has none, so a deep search stays local to its thread while
+// the wide top of the search tree spreads over all of them.
+template <typename Task> class WorkStealingPool final {
+  struct Queue final {
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+  };
+
+  std::vector<Queue> queues_;
+  std::atomic<size_t> pending_{0};
+  std::mutex errorMutex_;
+  std::exception_ptr error_;
+
+  bool pop(size_t indx, Task &task) {
+    auto &queue = queues_[indx];
+    std::lock_guard<std::mutex> lock{queue.mutex_};
+    if (queue.tasks_.empty())
+      return false;
+    task = std::move(queue.tasks_.back());
+    queue.tasks_.pop_back();
+    return true;
+  }
+
+  bool steal(size_t indx, Task &task) {
+    for (size_t i = 1; i != queues_.size(); ++i) {
+      auto &queue = queues_[(indx + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock{queue.mutex_};
+      if (queue.tasks_.empty())
+        continue;
+      task = std::move(queue.tasks_.front());
+      queue.tasks_.pop_front();
+      return true;
+    }
+    return false;
+  }
+
+public:
+  class Worker final {
+    WorkStealingPool &pool_;
+    size_t indx_;
+
+  public:
+    Worker(WorkStealingPool &pool, size_t indx) : pool_(pool), indx_(indx) {}
+
+    size_t getIndx() const noexcept { return indx_; }
+
+    void push(Task task) {
+      auto &queue = pool_.queues_[indx_];
+      ++pool_.pending_;
+      std::lock_guard<std::mutex> lock{queue.mutex_};
+      queue.tasks_.push_back(std::move(task));
+    }
+  };
+
+private:
+  template <typename Process> void work(size_t indx, Process &process) {
+    Worker worker{*this, indx};
+    Task task;
+    while (pending_ != 0) {
+      if (!pop(indx, task) && !steal(indx, task)) {
+        std::this_thread::yield();
+        continue;
+      }
+      try {
+        process(task, worker);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock{errorMutex_};
+        if (!error_)
+          error_ = std::current_exception();
+      }
+      --pending_;
+    }
+  }
+
+public:
+  explicit WorkStealingPool(size_t threads)
+      : queues_(std::max<size_t>(threads, 1U)) {}
+
+  size_t size() const noexcept { return queues_.size(); }
+
+  // Calls process(Task &, Worker &) for every task until none is left, the
+  // process pushes new tasks through the worker. The first exception thrown
+  // by a process is rethrown once all threads are done.
+  template <typename Process>
+  void run(std::vector<Task> tasks, Process process) {
+    pending_ = tasks.size();
+    for (size_t i = 0; i != tasks.size(); ++i)
+      queues_[i % size()].tasks_.push_back(std::move(tasks[i]));
+    std::vector<std::thread> threads;
+    for (size_t indx = 1; indx < size(); ++indx)
+      threads.emplace_back([this, indx, &process] { work(indx, process); });
+    work(0U, process);
+    for (auto &&thread : threads)
+      thread.join();
+    if (error_)
+      std::rethrow_exception(error_);
+  }
+};
+
+// Calls process(indx) for every indx below count, each on its own thread and
+// the first one on the calling thread.
+template <typename Process> void parallelFor(size_t count, Process process) {
+  std::vector<std::thread> threads;
+  for (size_t indx = 1; indx < count; ++indx)
+    threads.emplace_back([indx, &process] { process(indx); });
+  if (count != 0)
+    process(size_t{0});
+  for (auto &&thread : threads)
+    thread.join();
+}
+
+} // namespace machines
@@ -2,24 +2,87 @@
 
 #include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <deque>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "AbstractMachine.hpp"
+#include "Sweep.hpp"
 #include "Utils.hpp"
 
 namespace machines {
 
 class TMConverter;
+class TMEnumerator;
+class LoweredTuringMachine;
 
 namespace tm {
 
-class States final {
+// Symbols of the "alphabet:" section, the first one is the blank. Programs
+// without the section run on "0 1".
+struct Alphabet final {
+  std::string symbols_ = "01";
+
+  // Reads the section after its "alphabet:" header.
+  void read(std::istream &is) {
+    std::string pat;
+    std::getline(is, pat);
+    auto iss = utils::readLineToSS(is);
+    symbols_.clear();
+    while (iss >> pat) {
+      if (pat.size() != 1 || symbols_.find(pat) != symbols_.npos) {
+        auto msg = "Wrong symbol '" + pat + "'";
+        throw std::runtime_error(msg);
+      }
+      symbols_ += pat;
+    }
+    if (symbols_.size() < 2) {
+      auto msg = "Alphabet needs at least two symbols";
+      throw std::runtime_error(msg);
+    }
+  }
+
+  void dump(std::ostream &os) const {
+    os << "alphabet:\n";
+    for (auto &&sym : symbols_)
+      os << sym << "\t";
+    os << "\n\n";
+  }
+
+  bool isDefault() const noexcept { return symbols_ == "01"; }
+
+  size_t size() const noexcept { return symbols_.size(); }
+
+  // Alphabet of a program text, which is read up to its "states:" header.
+  static Alphabet peek(std::istream &is) {
+    Alphabet alphabet;
+    std::string pat;
+    is >> pat;
+    if (pat == "alphabet:")
+      alphabet.read(is);
+    return alphabet;
+  }
+};
+
+// Transition table over an alphabet of at most Symbols symbols. Symbols is a
+// build time constant, so a state keeps its jumps in place.
+template <unsigned Symbols> class BasicStates final {
+  static_assert(Symbols >= 2 && Symbols <= 256);
+
 public:
-  using Symbol = bool;
+  using Symbol = std::conditional_t<Symbols == 2, bool, std::uint8_t>;
   using StateIndx = unsigned int;
 
+  static constexpr unsigned SymbolsCount = Symbols;
+
   enum class Move : bool {
     L,
     R,
@@ -34,13 +97,14 @@ public:
   struct State final {
     StateIndx indx_;
     std::string name_;
-    std::array<Jump, 2U> jumps_;
+    std::array<Jump, Symbols> jumps_;
   };
 
 private:
   using StateStorage = std::vector<State>;
-  using StateConstIter = StateStorage::const_iterator;
+  using StateConstIter = typename StateStorage::const_iterator;
 
+  Alphabet alphabet_;
   StateStorage states_;
   StateIndx haltStateIndx_;
 
@@ -70,9 +134,16 @@ private:
     return move == Move::L ? "L" : "R";
   }
 
-  void readStates(std::istream &is) {
-    std::string pat, stateName;
-    is >> pat;
+  void readAlphabet(std::istream &is) {
+    alphabet_.read(is);
+    if (alphabet_.size() > Symbols) {
+      auto msg = "Alphabet has more than " + std::to_string(Symbols);
+      throw std::runtime_error(msg + " symbols");
+    }
+  }
+
+  void readStates(std::istream &is, std::string pat) {
+    std::string stateName;
     utils::checkPattern(pat, "states:");
     std::getline(is, pat);
     auto iss = utils::readLineToSS(is);
@@ -99,16 +170,16 @@ private:
     is >> pat;
     utils::checkPattern(pat, "table:");
     std::getline(is, pat);
-    Symbol sym, newSym;
-    for (size_t i = 0; i != 2 * (states_.size() - 1); ++i) {
+    char sym, newSym;
+    for (size_t i = 0; i != alphabet_.size() * (states_.size() - 1); ++i) {
       auto iss = utils::readLineToSS(is);
       iss >> stateName >> sym >> newSym >> nextStateName >> moveStr;
       auto stateIndx = getStateIndx(stateName);
       auto &state = states_.at(stateIndx);
-      auto &jump = state.jumps_[sym];
+      auto &jump = state.jumps_[strToSym(sym)];
       jump.move_ = strToMove(moveStr);
       jump.newStateIndx_ = getStateIndx(nextStateName);
-      jump.newSym_ = newSym;
+      jump.newSym_ = strToSym(newSym);
     }
   }
 
@@ -129,10 +200,11 @@ private:
     for (auto &&state : states_) {
       if (isHlt(state.indx_))
         continue;
-      for (size_t i = 0; i != state.jumps_.size(); ++i) {
+      for (size_t i = 0; i != alphabet_.size(); ++i) {
         const auto &jump = state.jumps_[i];
         const auto &newState = states_.at(jump.newStateIndx_);
-        os << state.name_ << "\t" << i << "\t" << jump.newSym_ << "\t";
+        os << state.name_ << "\t" << symToStr(static_cast<Symbol>(i)) << "\t";
+        os << symToStr(jump.newSym_) << "\t";
         os << newState.name_ << "\t" << moveToStr(jump.move_) << "\n";
       }
     }
@@ -141,7 +213,13 @@ private:
 
 public:
   void read(std::istream &is) {
-    readStates(is);
+    std::string pat;
+    is >> pat;
+    if (pat == "alphabet:") {
+      readAlphabet(is);
+      is >> pat;
+    }
+    readStates(is, pat);
     readHalt(is);
     readTable(is);
   }
@@ -153,6 +231,8 @@ public:
   }
 
   void dump(std::ostream &os) const {
+    if (!alphabet_.isDefault())
+      alphabet_.dump(os);
     dumpStates(os);
     dumpHalt(os);
     dumpTable(os);
@@ -165,30 +245,51 @@ public:
   StateConstIter begin() const noexcept { return states_.begin(); }
 
   StateConstIter end() const noexcept { return states_.end(); }
-};
 
-class Tape final {
-  using Symbol = States::Symbol;
-  using SymbolStorage = std::deque<Symbol>;
-  using StateIndx = States::StateIndx;
+  size_t size() const noexcept { return states_.size(); }
 
-  Symbol head_;
-  StateIndx curStateIndx_;
-  SymbolStorage left_;
-  SymbolStorage right_;
+  const Alphabet &getAlphabet() const noexcept { return alphabet_; }
 
-  static size_t toNumber(const SymbolStorage &symbols) {
-    size_t num = 0;
-    for (size_t i = 0; i != symbols.size(); ++i) {
-      if (symbols[i] == true) {
-        num += 1 << (symbols.size() - i - 1);
-      }
+  // Builds the table in memory, jumps of a new state lead to state 0.
+  StateIndx addState(std::string name) {
+    auto indx = static_cast<StateIndx>(states_.size());
+    states_.emplace_back(State{indx, std::move(name), {}});
+    return indx;
+  }
+
+  void setHalt(StateIndx indx) { haltStateIndx_ = indx; }
+
+  void setJump(StateIndx indx, Symbol sym, const Jump &jump) {
+    states_.at(indx).jumps_[sym] = jump;
+  }
+
+  Symbol strToSym(char sym) const {
+    auto found = alphabet_.symbols_.find(sym);
+    if (found == alphabet_.symbols_.npos) {
+      auto msg = "Unknown symbol '" + std::string(1, sym) + "'";
+      throw std::runtime_error(msg);
     }
-    return num;
+    return static_cast<Symbol>(found);
   }
 
-public:
-  void read(std::istream &is, const States &states) {
+  char symToStr(Symbol sym) const noexcept { return alphabet_.symbols_[sym]; }
+};
+
+using States = BasicStates<2U>;
+
+// Parsed "initial:" section, shared by all tape representations. Symbols are
+// stored as their indices in the alphabet of the states.
+struct TapeImage final {
+  using Symbol = std::uint8_t;
+  using SymbolStorage = std::vector<Symbol>;
+
+  SymbolStorage left_;
+  Symbol head_;
+  SymbolStorage right_;
+  std::string stateName_;
+
+  template <typename StatesT>
+  void read(std::istream &is, const StatesT &states) {
     std::string pat, tapeStr;
     is >> pat;
     utils::checkPattern(pat, "initial:");
@@ -198,35 +299,112 @@ public:
     utils::checkPattern(tapeStr, "]");
     auto leftBound = tapeStr.begin() + tapeStr.find('[');
     auto rightBound = tapeStr.begin() + tapeStr.find(']');
-    assert(leftBound < rightBound);
+    if (leftBound == tapeStr.begin() || leftBound > rightBound) {
+      auto msg = "Wrong tape '" + tapeStr + "'";
+      throw std::runtime_error(msg);
+    }
     for (auto it = tapeStr.begin(); it != std::prev(leftBound); ++it)
-      left_.emplace_back(strToSym(*it));
-    head_ = strToSym(*std::prev(leftBound));
+      left_.emplace_back(states.strToSym(*it));
+    head_ = states.strToSym(*std::prev(leftBound));
     for (auto it = std::next(rightBound); it != tapeStr.end(); ++it)
-      right_.emplace_back(strToSym(*it));
-    auto curStateName = std::string(std::next(leftBound), rightBound);
-    curStateIndx_ = states.getState(curStateName).indx_;
+      right_.emplace_back(states.strToSym(*it));
+    stateName_ = std::string(std::next(leftBound), rightBound);
+  }
+};
+
+// Absolute head position and tape bounds, counted from the initial head.
+struct TapeExtent final {
+  using Offset = std::ptrdiff_t;
+
+  Offset lo_;
+  Offset head_;
+  Offset hi_;
+
+  void dump(std::ostream &os) const {
+    os << " head " << head_ << " tape " << lo_ << ".." << hi_ << "\n";
+  }
+};
+
+// Reference tape: one deque element per cell on each side of the head.
+template <unsigned Symbols> class BasicDequeTape final {
+public:
+  using States = BasicStates<Symbols>;
+
+private:
+  using Symbol = typename States::Symbol;
+  using SymbolStorage = std::deque<Symbol>;
+  using StateIndx = typename States::StateIndx;
+
+  Symbol head_;
+  StateIndx curStateIndx_;
+  SymbolStorage left_;
+  SymbolStorage right_;
+  // Offset of the first cell of left_, or of the head if left_ is empty. It
+  // changes only when a cell is added or dropped at that end, so moves do
+  // not count the head position and getExtent works it out from the sizes.
+  TapeExtent::Offset lo_;
+
+  template <typename Iter> static size_t toNumber(Iter first, Iter last) {
+    size_t num = 0;
+    for (; first != last; ++first)
+      num = (num << 1) | *first;
+    return num;
+  }
+
+public:
+  void read(std::istream &is, const States &states) {
+    TapeImage image;
+    image.read(is, states);
+    load(image, states);
+  }
+
+  void load(const TapeImage &image, const States &states) {
+    left_.assign(image.left_.begin(), image.left_.end());
+    head_ = image.head_;
+    right_.assign(image.right_.begin(), image.right_.end());
+    lo_ = -static_cast<TapeExtent::Offset>(left_.size());
+    curStateIndx_ = states.getState(image.stateName_).indx_;
   }
 
   void dump(std::ostream &os, const States &states) const {
     for (auto &&sym : left_)
-      os << symToStr(sym);
-    os << symToStr(head_);
+      os << states.symToStr(sym);
+    os << states.symToStr(head_);
     os << '[' << states.getState(curStateIndx_).name_ << ']';
     for (auto &&sym : right_)
-      os << symToStr(sym);
+      os << states.symToStr(sym);
     os << "\n";
   }
 
+  // Dumps at most window cells on each side of the head.
+  void dumpWindow(std::ostream &os, const States &states, size_t window) const {
+    auto leftCount = std::min(window, left_.size());
+    for (auto it = left_.end() - leftCount; it != left_.end(); ++it)
+      os << states.symToStr(*it);
+    os << states.symToStr(head_);
+    os << '[' << states.getState(curStateIndx_).name_ << ']';
+    auto rightCount = std::min(window, right_.size());
+    for (auto it = right_.begin(); it != right_.begin() + rightCount; ++it)
+      os << states.symToStr(*it);
+    getExtent().dump(os);
+  }
+
+  TapeExtent getExtent() const {
+    auto pos = lo_ + static_cast<TapeExtent::Offset>(left_.size());
+    auto hi = pos + static_cast<TapeExtent::Offset>(right_.size());
+    return TapeExtent{lo_, pos, hi};
+  }
+
   void moveLeft(Symbol newSym) {
     right_.emplace_front(newSym);
     if (!left_.empty()) {
       head_ = left_.back();
       left_.pop_back();
     } else {
-      head_ = false;
+      head_ = Symbol{};
+      --lo_;
     }
-    if (right_.back() == false)
+    if (right_.back() == Symbol{})
       right_.pop_back();
   }
 
@@ -236,82 +414,1127 @@ public:
       head_ = right_.front();
       right_.pop_front();
     } else {
-      head_ = false;
+      head_ = Symbol{};
     }
-    if (left_.front() == false)
+    if (left_.front() == Symbol{}) {
       left_.pop_front();
+      ++lo_;
+    }
   }
 
-  size_t leftNumber() const { return toNumber(left_); }
+  // Tape halves as numbers, the cell next to the head being the lowest digit.
+  size_t leftNumber() const { return toNumber(left_.begin(), left_.end()); }
 
-  size_t rightNumber() const { return toNumber(right_); }
+  size_t rightNumber() const {
+    return toNumber(right_.rbegin(), right_.rend());
+  }
 
   void setCurStateIndx(StateIndx curStateIndx) { curStateIndx_ = curStateIndx; }
 
   StateIndx getCurStateIndx() const { return curStateIndx_; }
 
   Symbol getHead() const { return head_; }
+};
+
+using DequeTape = BasicDequeTape<2U>;
+
+// Result of running the machine inside one block of cells until the head
+// leaves the block or the machine halts.
+struct BlockJump final {
+  using Block = unsigned long long;
+  using StateIndx = States::StateIndx;
+
+  Block block_;
+  StateIndx newStateIndx_;
+  int headPos_; // -1 or the block size if the head left the block
+  int minPos_;
+  int maxPos_;
+  size_t steps_;
+  size_t rights_;
+  size_t lefts_;
+};
+
+// Tape packed into 64-bit words, most significant bit first. The head and
+// the shown bounds [lo_, hi_] are bit offsets into words_; cells outside the
+// bounds are always zero. Words are added on whichever side the head runs
+// out of, doubling the storage, so moves are amortized O(1).
+//
+// The word under the head is cached in cur_ and written back only when the
+// head leaves it, so a step does not wait for its own store to be reloaded.
+// The symbol under the head is cached in sym_, read from the word as it was
+// before the write, as the write never lands on the cell the head moves to.
+//
+// Bounds are trimmed exactly as DequeTape does it: each move drops at most
+// one blank cell from the far end of the side the head moves away from.
+class PackedTape final {
+public:
+  using States = tm::States;
 
 private:
-  static Symbol strToSym(char sym) {
-    switch (sym) {
-    case '0':
+  using Symbol = States::Symbol;
+  using StateIndx = States::StateIndx;
+  using Word = unsigned long long;
+  using WordStorage = std::vector<Word>;
+  using Pos = size_t;
+
+  static constexpr Pos WordBits = 64U;
+  static_assert(sizeof(Word) * 8 == WordBits);
+
+  WordStorage words_;
+  Word cur_;
+  Symbol sym_;
+  Pos head_;
+  Pos lo_;
+  Pos hi_;
+  Pos origin_;
+  StateIndx curStateIndx_;
+
+  static constexpr Word mask(Pos pos) noexcept {
+    return Word{1} << (WordBits - 1 - pos % WordBits);
+  }
+
+  static constexpr Word lowMask(Pos len) noexcept {
+    return len == WordBits ? ~Word{0} : (Word{1} << len) - 1;
+  }
+
+  Word wordAt(Pos indx) const noexcept {
+    return indx == head_ / WordBits ? cur_ : words_[indx];
+  }
+
+  Symbol get(Pos pos) const noexcept {
+    return wordAt(pos / WordBits) & mask(pos);
+  }
+
+  void set(Pos pos, Symbol sym) noexcept {
+    auto &word = words_[pos / WordBits];
+    word = (word & ~mask(pos)) | ((Word{0} - sym) & mask(pos));
+  }
+
+  void writeHead(Symbol sym) noexcept {
+    cur_ = (cur_ & ~mask(head_)) | ((Word{0} - sym) & mask(head_));
+  }
+
+  void growLeft() {
+    auto added = words_.size();
+    words_.insert(words_.begin(), added, Word{0});
+    head_ += added * WordBits;
+    lo_ += added * WordBits;
+    hi_ += added * WordBits;
+    origin_ += added * WordBits;
+  }
+
+  void growRight() { words_.resize(2 * words_.size(), Word{0}); }
+
+  // Bits [from, to) read as a binary number, the first bit being the highest.
+  size_t toNumber(Pos from, Pos to) const noexcept {
+    size_t num = 0;
+    while (from < to) {
+      auto offset = from % WordBits;
+      auto len = std::min(WordBits - offset, to - from);
+      auto bits = wordAt(from / WordBits) << offset >> (WordBits - len);
+      num = len == WordBits ? bits : (num << len) | bits;
+      from += len;
+    }
+    return num;
+  }
+
+  // Writes len <= 64 cells starting at from, the first cell being the highest
+  // of the len low bits. The head word must be flushed to words_.
+  void writeBits(Pos from, Pos len, Word bits) noexcept {
+    while (len != 0) {
+      auto offset = from % WordBits;
+      auto count = std::min(WordBits - offset, len);
+      auto shift = WordBits - offset - count;
+      auto chunk = (bits >> (len - count)) & lowMask(count);
+      auto &word = words_[from / WordBits];
+      word = (word & ~(lowMask(count) << shift)) | (chunk << shift);
+      from += count;
+      len -= count;
+    }
+  }
+
+  // Blank cells in a row starting at from and going right, at most limit.
+  Pos zerosFrom(Pos from, Pos limit) const noexcept {
+    Pos zeros = 0;
+    while (zeros < limit) {
+      auto offset = from % WordBits;
+      auto word = wordAt(from / WordBits) << offset;
+      auto avail = WordBits - offset;
+      auto found =
+          word == 0 ? avail : std::min<Pos>(__builtin_clzll(word), avail);
+      zeros += found;
+      if (found != avail)
+        break;
+      from += avail;
+    }
+    return std::min(zeros, limit);
+  }
+
+  // Blank cells in a row starting at from and going left, at most limit.
+  Pos zerosBefore(Pos from, Pos limit) const noexcept {
+    Pos zeros = 0;
+    while (zeros < limit) {
+      auto offset = WordBits - 1 - from % WordBits;
+      auto word = wordAt(from / WordBits) >> offset;
+      auto avail = WordBits - offset;
+      auto found =
+          word == 0 ? avail : std::min<Pos>(__builtin_ctzll(word), avail);
+      zeros += found;
+      if (found != avail || from < avail)
+        break;
+      from -= avail;
+    }
+    return std::min(zeros, limit);
+  }
+
+  // Bits of a word in the opposite order.
+  static constexpr Word reverse(Word word) noexcept {
+    constexpr Word Odd = 0x5555555555555555ULL;
+    constexpr Word Pairs = 0x3333333333333333ULL;
+    constexpr Word Nibbles = 0x0F0F0F0F0F0F0F0FULL;
+    word = (word >> 1 & Odd) | (word & Odd) << 1;
+    word = (word >> 2 & Pairs) | (word & Pairs) << 2;
+    word = (word >> 4 & Nibbles) | (word & Nibbles) << 4;
+    return __builtin_bswap64(word);
+  }
+
+  // Writes the cells of every word a nibble at a time.
+  void appendSymbols(std::string &str, const States &states, Pos from,
+                     Pos to) const {
+    if (from >= to)
+      return;
+    std::array<char, 2> syms{states.symToStr(false), states.symToStr(true)};
+    std::array<std::array<char, 4>, 16> nibbles;
+    for (size_t nibble = 0; nibble != nibbles.size(); ++nibble)
+      for (size_t i = 0; i != 4; ++i)
+        nibbles[nibble][i] = syms[nibble >> (3 - i) & 1U];
+    auto size = str.size();
+    str.resize(size + (to - from));
+    auto *out = str.data() + size;
+    while (from < to) {
+      auto offset = from % WordBits;
+      auto len = std::min(WordBits - offset, to - from);
+      auto word = wordAt(from / WordBits) << offset;
+      Pos i = 0;
+      for (; i + 4 <= len; i += 4, word <<= 4, out += 4)
+        std::copy_n(nibbles[word >> (WordBits - 4)].data(), 4, out);
+      for (; i != len; ++i, word <<= 1)
+        *out++ = syms[word >> (WordBits - 1)];
+      from += len;
+    }
+  }
+
+public:
+  void read(std::istream &is, const States &states) {
+    TapeImage image;
+    image.read(is, states);
+    load(image, states);
+  }
+
+  void load(const TapeImage &image, const States &states) {
+    auto size = image.left_.size() + 1 + image.right_.size();
+    words_.assign(size / WordBits + 1, Word{0});
+    lo_ = 0;
+    head_ = image.left_.size();
+    hi_ = size - 1;
+    Pos pos = lo_;
+    for (auto &&sym : image.left_)
+      set(pos++, sym);
+    set(pos++, image.head_);
+    for (auto &&sym : image.right_)
+      set(pos++, sym);
+    cur_ = words_[head_ / WordBits];
+    sym_ = cur_ & mask(head_);
+    origin_ = head_;
+    curStateIndx_ = states.getState(image.stateName_).indx_;
+  }
+
+  void dump(std::ostream &os, const States &states) const {
+    std::string str;
+    appendSymbols(str, states, lo_, head_ + 1);
+    str.append(1, '[').append(states.getState(curStateIndx_).name_);
+    str.push_back(']');
+    appendSymbols(str, states, head_ + 1, hi_ + 1);
+    str.push_back('\n');
+    os << str;
+  }
+
+  // Dumps at most window cells on each side of the head.
+  void dumpWindow(std::ostream &os, const States &states, size_t window) const {
+    std::string str;
+    auto from = std::max(lo_, head_ - std::min(window, head_));
+    appendSymbols(str, states, from, head_ + 1);
+    str.append(1, '[').append(states.getState(curStateIndx_).name_);
+    str.push_back(']');
+    appendSymbols(str, states, head_ + 1, std::min(hi_, head_ + window) + 1);
+    os << str;
+    getExtent().dump(os);
+  }
+
+  TapeExtent getExtent() const {
+    auto offset = [this](Pos pos) {
+      return static_cast<TapeExtent::Offset>(pos) -
+             static_cast<TapeExtent::Offset>(origin_);
+    };
+    return TapeExtent{offset(lo_), offset(head_), offset(hi_)};
+  }
+
+  void moveLeft(Symbol newSym) {
+    auto word = cur_;
+    writeHead(newSym);
+    if (head_ % WordBits == 0) {
+      words_[head_ / WordBits] = cur_;
+      if (head_ == 0)
+        growLeft();
+      cur_ = word = words_[head_ / WordBits - 1];
+    }
+    --head_;
+    sym_ = word & mask(head_);
+    hi_ -= !get(hi_);
+    lo_ = std::min(lo_, head_);
+  }
+
+  void moveRight(Symbol newSym) {
+    auto word = cur_;
+    writeHead(newSym);
+    if (++head_ % WordBits == 0) {
+      words_[head_ / WordBits - 1] = cur_;
+      if (head_ == words_.size() * WordBits)
+        growRight();
+      cur_ = word = words_[head_ / WordBits];
+    }
+    sym_ = word & mask(head_);
+    lo_ += !get(lo_);
+    hi_ = std::max(hi_, head_);
+  }
+
+  // Tape halves as numbers, the cell next to the head being the lowest digit.
+  size_t leftNumber() const { return toNumber(lo_, head_); }
+
+  // Only the 64 cells next to the head fit, as on the other tapes.
+  size_t rightNumber() const {
+    auto len = std::min(hi_ - head_, WordBits);
+    if (len == 0)
+      return 0;
+    return reverse(toNumber(head_ + 1, head_ + 1 + len)) >> (WordBits - len);
+  }
+
+  void setCurStateIndx(StateIndx curStateIndx) { curStateIndx_ = curStateIndx; }
+
+  StateIndx getCurStateIndx() const { return curStateIndx_; }
+
+  Symbol getHead() const { return sym_; }
+
+  // Offset of the head in its block, blocks are aligned on the initial head.
+  Pos blockOffset(Pos size) const noexcept {
+    if (head_ >= origin_)
+      return (head_ - origin_) % size;
+    return (size - (origin_ - head_) % size) % size;
+  }
+
+  // Makes room for the head block and the cells on both sides of it.
+  void reserveBlock(Pos size) {
+    auto offset = blockOffset(size);
+    while (head_ < offset + 1)
+      growLeft();
+    while (head_ - offset + size >= words_.size() * WordBits)
+      growRight();
+  }
+
+  BlockJump::Block readBlock(Pos size) const noexcept {
+    auto from = head_ - blockOffset(size);
+    return toNumber(from, from + size);
+  }
+
+  // Applies a jump made inside the head block. Bound trimming depends on the
+  // order of moves, so the jump is refused if a bound could reach the block.
+  bool jumpBlock(Pos size, const BlockJump &jump) {
+    auto from = head_ - blockOffset(size);
+    auto last = from + size - 1;
+    auto lo = lo_, hi = hi_;
+    if (jump.rights_ != 0) {
+      if (lo >= from)
+        return false;
+      lo += zerosFrom(lo, std::min<Pos>(jump.rights_, from - lo));
+      if (lo == from)
+        return false;
+    } else {
+      lo = std::min<Pos>(lo, from + jump.minPos_);
+    }
+    if (jump.lefts_ != 0) {
+      if (hi <= last)
+        return false;
+      hi -= zerosBefore(hi, std::min<Pos>(jump.lefts_, hi - last));
+      if (hi == last)
+        return false;
+    } else {
+      hi = std::max<Pos>(hi, from + jump.maxPos_);
+    }
+    words_[head_ / WordBits] = cur_;
+    writeBits(from, size, jump.block_);
+    head_ = from + jump.headPos_;
+    cur_ = words_[head_ / WordBits];
+    sym_ = cur_ & mask(head_);
+    lo_ = lo;
+    hi_ = hi;
+    curStateIndx_ = jump.newStateIndx_;
+    return true;
+  }
+};
+
+// Tape stored as runs of equal cells on each side of the head, so long
+// uniform stretches cost one element. Runs are ordered like the cells of
+// DequeTape and neighbouring runs never hold the same symbol.
+class RunLengthTape final {
+public:
+  using States = tm::States;
+
+private:
+  using Symbol = States::Symbol;
+  using StateIndx = States::StateIndx;
+
+  struct Run final {
+    Symbol sym_;
+    size_t count_;
+  };
+
+  using RunStorage = std::deque<Run>;
+
+  Symbol head_;
+  StateIndx curStateIndx_;
+  RunStorage left_;
+  RunStorage right_;
+  size_t leftCells_;
+  size_t rightCells_;
+  TapeExtent::Offset pos_;
+
+  static void pushBack(RunStorage &runs, Symbol sym, size_t count) {
+    if (!runs.empty() && runs.back().sym_ == sym)
+      runs.back().count_ += count;
+    else
+      runs.emplace_back(Run{sym, count});
+  }
+
+  static void pushFront(RunStorage &runs, Symbol sym, size_t count) {
+    if (!runs.empty() && runs.front().sym_ == sym)
+      runs.front().count_ += count;
+    else
+      runs.emplace_front(Run{sym, count});
+  }
+
+  static Symbol popBack(RunStorage &runs) {
+    if (runs.empty())
       return false;
-    case '1':
-      return true;
-    default: {
-      auto msg = "Unknown symbol '" + std::string(1, sym) + "'";
-      throw std::runtime_error(msg);
+    auto sym = runs.back().sym_;
+    if (--runs.back().count_ == 0)
+      runs.pop_back();
+    return sym;
+  }
+
+  static Symbol popFront(RunStorage &runs) {
+    if (runs.empty())
+      return false;
+    auto sym = runs.front().sym_;
+    if (--runs.front().count_ == 0)
+      runs.pop_front();
+    return sym;
+  }
+
+  // Drops up to count blank cells from the far end of a side, one per move.
+  // Returns the number of dropped cells.
+  static size_t trimBack(RunStorage &runs, size_t count) {
+    if (runs.empty() || runs.back().sym_ == true)
+      return 0U;
+    auto &run = runs.back();
+    auto trimmed = std::min(count, run.count_);
+    run.count_ -= trimmed;
+    if (run.count_ == 0)
+      runs.pop_back();
+    return trimmed;
+  }
+
+  static size_t trimFront(RunStorage &runs, size_t count) {
+    if (runs.empty() || runs.front().sym_ == true)
+      return 0U;
+    auto &run = runs.front();
+    auto trimmed = std::min(count, run.count_);
+    run.count_ -= trimmed;
+    if (run.count_ == 0)
+      runs.pop_front();
+    return trimmed;
+  }
+
+  template <typename Iter> static size_t toNumber(Iter first, Iter last) {
+    size_t num = 0;
+    for (; first != last; ++first) {
+      for (size_t i = 0; i != first->count_; ++i)
+        num = (num << 1) | first->sym_;
+    }
+    return num;
+  }
+
+  static void dumpRuns(std::ostream &os, const States &states,
+                       const RunStorage &runs) {
+    for (auto &&run : runs)
+      os << std::string(run.count_, states.symToStr(run.sym_));
+  }
+
+public:
+  void read(std::istream &is, const States &states) {
+    TapeImage image;
+    image.read(is, states);
+    load(image, states);
+  }
+
+  void load(const TapeImage &image, const States &states) {
+    left_.clear();
+    right_.clear();
+    for (auto &&sym : image.left_)
+      pushBack(left_, sym, 1U);
+    head_ = image.head_;
+    for (auto &&sym : image.right_)
+      pushBack(right_, sym, 1U);
+    leftCells_ = image.left_.size();
+    rightCells_ = image.right_.size();
+    pos_ = 0;
+    curStateIndx_ = states.getState(image.stateName_).indx_;
+  }
+
+  void dump(std::ostream &os, const States &states) const {
+    dumpRuns(os, states, left_);
+    os << states.symToStr(head_);
+    os << '[' << states.getState(curStateIndx_).name_ << ']';
+    dumpRuns(os, states, right_);
+    os << "\n";
+  }
+
+  // Dumps at most window cells on each side of the head.
+  void dumpWindow(std::ostream &os, const States &states, size_t window) const {
+    std::string str;
+    for (auto it = left_.rbegin(); it != left_.rend() && str.size() < window;
+         ++it)
+      str.append(std::min(it->count_, window - str.size()),
+                 states.symToStr(it->sym_));
+    std::reverse(str.begin(), str.end());
+    str.push_back(states.symToStr(head_));
+    str.append(1, '[').append(states.getState(curStateIndx_).name_);
+    str.push_back(']');
+    size_t count = 0;
+    for (auto it = right_.begin(); it != right_.end() && count < window; ++it) {
+      auto len = std::min(it->count_, window - count);
+      str.append(len, states.symToStr(it->sym_));
+      count += len;
+    }
+    os << str;
+    getExtent().dump(os);
+  }
+
+  TapeExtent getExtent() const {
+    auto lo = pos_ - static_cast<TapeExtent::Offset>(leftCells_);
+    auto hi = pos_ + static_cast<TapeExtent::Offset>(rightCells_);
+    return TapeExtent{lo, pos_, hi};
+  }
+
+  void moveLeft(Symbol newSym) {
+    --pos_;
+    pushFront(right_, newSym, 1U);
+    leftCells_ -= !left_.empty();
+    head_ = popBack(left_);
+    rightCells_ += 1U - trimBack(right_, 1U);
+  }
+
+  void moveRight(Symbol newSym) {
+    ++pos_;
+    pushBack(left_, newSym, 1U);
+    rightCells_ -= !right_.empty();
+    head_ = popFront(right_);
+    leftCells_ += 1U - trimFront(left_, 1U);
+  }
+
+  // Moves left across the run of cells equal to the head, writing newSym in
+  // all of them, as a state looping on the head symbol would do. Each of
+  // these moves could trim one blank cell from the right end.
+  void chainLeft(Symbol newSym) {
+    size_t count = 1U;
+    if (!left_.empty() && left_.back().sym_ == head_) {
+      count += left_.back().count_;
+      left_.pop_back();
     }
+    pos_ -= static_cast<TapeExtent::Offset>(count);
+    pushFront(right_, newSym, count);
+    leftCells_ -= count - 1U + !left_.empty();
+    head_ = popBack(left_);
+    rightCells_ += count - trimBack(right_, count);
+  }
+
+  void chainRight(Symbol newSym) {
+    size_t count = 1U;
+    if (!right_.empty() && right_.front().sym_ == head_) {
+      count += right_.front().count_;
+      right_.pop_front();
     }
+    pos_ += static_cast<TapeExtent::Offset>(count);
+    pushBack(left_, newSym, count);
+    rightCells_ -= count - 1U + !right_.empty();
+    head_ = popFront(right_);
+    leftCells_ += count - trimFront(left_, count);
+  }
+
+  // Tape halves as numbers, the cell next to the head being the lowest digit.
+  size_t leftNumber() const { return toNumber(left_.begin(), left_.end()); }
+
+  size_t rightNumber() const {
+    return toNumber(right_.rbegin(), right_.rend());
   }
 
-  static char symToStr(bool sym) { return sym ? '1' : '0'; }
+  void setCurStateIndx(StateIndx curStateIndx) { curStateIndx_ = curStateIndx; }
+
+  StateIndx getCurStateIndx() const { return curStateIndx_; }
+
+  Symbol getHead() const { return head_; }
 };
 
-class TuringMachine final : public machines::Machine<TuringMachine> {
+// Packed tape for alphabets of more than two symbols: a cell takes Bits bits
+// of a word, the first cell being the highest. Moves and bound trimming
+// follow DequeTape.
+template <unsigned Symbols> class WidePackedTape final {
+public:
+  using States = BasicStates<Symbols>;
+
+private:
+  using Symbol = typename States::Symbol;
+  using StateIndx = typename States::StateIndx;
+  using Word = unsigned long long;
+  using WordStorage = std::vector<Word>;
+  using Pos = size_t;
+
+  static_assert(Symbols > 2U);
+  static constexpr Pos Bits = Symbols <= 4U ? 2U : Symbols <= 16U ? 4U : 8U;
+  static constexpr Pos WordCells = 64U / Bits;
+  static constexpr Word CellMask = (Word{1} << Bits) - 1;
+
+  WordStorage words_;
+  Pos head_;
+  Pos lo_;
+  Pos hi_;
+  Pos origin_;
+  StateIndx curStateIndx_;
+
+  static constexpr Pos shift(Pos pos) noexcept {
+    return (WordCells - 1 - pos % WordCells) * Bits;
+  }
+
+  Symbol get(Pos pos) const noexcept {
+    auto word = words_[pos / WordCells];
+    return static_cast<Symbol>(word >> shift(pos) & CellMask);
+  }
+
+  void set(Pos pos, Symbol sym) noexcept {
+    auto &word = words_[pos / WordCells];
+    word = (word & ~(CellMask << shift(pos))) | (Word{sym} << shift(pos));
+  }
+
+  void growLeft() {
+    auto added = words_.size();
+    words_.insert(words_.begin(), added, Word{0});
+    head_ += added * WordCells;
+    lo_ += added * WordCells;
+    hi_ += added * WordCells;
+    origin_ += added * WordCells;
+  }
+
+  void growRight() { words_.resize(2 * words_.size(), Word{0}); }
+
+  void appendSymbols(std::string &str, const States &states, Pos from,
+                     Pos to) const {
+    for (; from < to; ++from)
+      str.push_back(states.symToStr(get(from)));
+  }
+
+public:
+  void read(std::istream &is, const States &states) {
+    TapeImage image;
+    image.read(is, states);
+    load(image, states);
+  }
+
+  void load(const TapeImage &image, const States &states) {
+    auto size = image.left_.size() + 1 + image.right_.size();
+    words_.assign(size / WordCells + 1, Word{0});
+    lo_ = 0;
+    head_ = image.left_.size();
+    hi_ = size - 1;
+    Pos pos = lo_;
+    for (auto &&sym : image.left_)
+      set(pos++, sym);
+    set(pos++, image.head_);
+    for (auto &&sym : image.right_)
+      set(pos++, sym);
+    origin_ = head_;
+    curStateIndx_ = states.getState(image.stateName_).indx_;
+  }
+
+  void dump(std::ostream &os, const States &states) const {
+    std::string str;
+    appendSymbols(str, states, lo_, head_ + 1);
+    str.append(1, '[').append(states.getState(curStateIndx_).name_);
+    str.push_back(']');
+    appendSymbols(str, states, head_ + 1, hi_ + 1);
+    str.push_back('\n');
+    os << str;
+  }
+
+  // Dumps at most window cells on each side of the head.
+  void dumpWindow(std::ostream &os, const States &states, size_t window) const {
+    std::string str;
+    auto from = std::max(lo_, head_ - std::min(window, head_));
+    appendSymbols(str, states, from, head_ + 1);
+    str.append(1, '[').append(states.getState(curStateIndx_).name_);
+    str.push_back(']');
+    appendSymbols(str, states, head_ + 1, std::min(hi_, head_ + window) + 1);
+    os << str;
+    getExtent().dump(os);
+  }
+
+  TapeExtent getExtent() const {
+    auto offset = [this](Pos pos) {
+      return static_cast<TapeExtent::Offset>(pos) -
+             static_cast<TapeExtent::Offset>(origin_);
+    };
+    return TapeExtent{offset(lo_), offset(head_), offset(hi_)};
+  }
+
+  void moveLeft(Symbol newSym) {
+    set(head_, newSym);
+    if (head_ == 0)
+      growLeft();
+    --head_;
+    if (get(hi_) == Symbol{})
+      --hi_;
+    lo_ = std::min(lo_, head_);
+  }
+
+  void moveRight(Symbol newSym) {
+    set(head_, newSym);
+    if (++head_ == words_.size() * WordCells)
+      growRight();
+    if (get(lo_) == Symbol{})
+      ++lo_;
+    hi_ = std::max(hi_, head_);
+  }
+
+  void setCurStateIndx(StateIndx curStateIndx) { curStateIndx_ = curStateIndx; }
+
+  StateIndx getCurStateIndx() const { return curStateIndx_; }
+
+  Symbol getHead() const { return get(head_); }
+};
+
+// Packed tape for alphabets of at most Symbols symbols.
+template <unsigned Symbols>
+using BasicPackedTape =
+    std::conditional_t<Symbols == 2U, PackedTape, WidePackedTape<Symbols>>;
+
+// The deque tape steps fastest, so it is the tape of ETM, CTM and the rest.
+using Tape = DequeTape;
+
+// Transitions of the macro machine whose symbols are blocks of size cells.
+// A transition is keyed on the state, the block contents and the side the
+// head stands on, and is simulated the first time it is needed.
+class BlockCache final {
+  using Block = BlockJump::Block;
+  using StateIndx = States::StateIndx;
+  using Key = std::uint64_t;
+  using JumpStorage = std::unordered_map<Key, BlockJump>;
+
+  const States &states_;
+  unsigned size_;
+  JumpStorage jumps_;
+
+  BlockJump simulate(StateIndx stateIndx, Block block, bool rightSide) const {
+    BlockJump res{};
+    int pos = rightSide ? size_ - 1 : 0;
+    res.minPos_ = res.maxPos_ = pos;
+    while (pos >= 0 && pos < static_cast<int>(size_) &&
+           !states_.isHlt(stateIndx)) {
+      auto shift = size_ - 1 - pos;
+      const auto &jump =
+          states_.getState(stateIndx).jumps_[(block >> shift) & 1U];
+      block = (block & ~(Block{1} << shift)) | (Block{jump.newSym_} << shift);
+      if (jump.move_ == States::Move::L) {
+        --pos;
+        ++res.lefts_;
+      } else {
+        ++pos;
+        ++res.rights_;
+      }
+      ++res.steps_;
+      res.minPos_ = std::min(res.minPos_, pos);
+      res.maxPos_ = std::max(res.maxPos_, pos);
+      stateIndx = jump.newStateIndx_;
+    }
+    res.block_ = block;
+    res.newStateIndx_ = stateIndx;
+    res.headPos_ = pos;
+    return res;
+  }
+
+public:
+  // Smaller blocks miss the cache too often to beat plain steps: BB5 runs
+  // as fast as plain steps on blocks of 10 cells and slower below.
+  static constexpr unsigned MinSize = 12U;
+  static constexpr unsigned MaxSize = 32U;
+
+  BlockCache(const States &states, unsigned size)
+      : states_(states), size_(size) {
+    if (size_ < MinSize || size_ > MaxSize) {
+      auto msg = "Block size must be in [" + std::to_string(MinSize) + ", " +
+                 std::to_string(MaxSize) + "]";
+      throw std::runtime_error(msg);
+    }
+  }
+
+  const BlockJump &get(StateIndx stateIndx, Block block, bool rightSide) {
+    auto key = Key{stateIndx} << (MaxSize + 1) | Key{block} << 1 | rightSide;
+    auto found = jumps_.find(key);
+    if (found == jumps_.end())
+      found = jumps_.emplace(key, simulate(stateIndx, block, rightSide)).first;
+    return found->second;
+  }
+};
+
+// Jumps of all states packed into one array indexed by state * 2 + symbol,
+// each entry holding the new state, the move and the new symbol. States are
+// numbered in the order of their indices until renumber() sorts them by the
+// hits counted so far, so the hot ones share cache lines.
+class FlatTable final {
+public:
+  using StateIndx = States::StateIndx;
   using Symbol = States::Symbol;
-  using StateVal = States::StateIndx;
+  using Entry = std::uint32_t;
 
-  States states_;
-  Tape tape_;
+  static constexpr Entry SymBit = 1U;
+  static constexpr Entry RightBit = 2U;
+  static constexpr unsigned StateShift = 2U;
 
-  void read(std::istream &is) {
-    states_.read(is);
-    tape_.read(is, states_);
+private:
+  using EntryStorage = std::vector<Entry>;
+  using IndxStorage = std::vector<StateIndx>;
+  using HitStorage = std::vector<size_t>;
+
+  const States &states_;
+  EntryStorage jumps_;
+  IndxStorage toFlat_;
+  IndxStorage toState_;
+  HitStorage hits_;
+
+  void build() {
+    jumps_.assign(2 * states_.size(), Entry{0});
+    for (auto &&state : states_) {
+      if (states_.isHlt(state.indx_))
+        continue;
+      auto flat = toFlat_[state.indx_];
+      for (size_t sym = 0; sym != state.jumps_.size(); ++sym) {
+        const auto &jump = state.jumps_[sym];
+        auto entry = Entry{toFlat_[jump.newStateIndx_]} << StateShift;
+        if (jump.move_ == States::Move::R)
+          entry |= RightBit;
+        if (jump.newSym_)
+          entry |= SymBit;
+        jumps_[2 * flat + sym] = entry;
+      }
+    }
   }
 
+public:
+  explicit FlatTable(const States &states)
+      : states_(states), toFlat_(states.size()), toState_(states.size()),
+        hits_(states.size()) {
+    if (states_.size() > (Entry{1} << (32U - StateShift))) {
+      auto msg = "Too many states for the flat table";
+      throw std::runtime_error(msg);
+    }
+    for (StateIndx i = 0; i != toFlat_.size(); ++i)
+      toFlat_[i] = toState_[i] = i;
+    build();
+  }
+
+  static size_t indx(StateIndx flat, Symbol sym) noexcept {
+    return 2 * size_t{flat} + sym;
+  }
+
+  const Entry *data() const noexcept { return jumps_.data(); }
+
+  StateIndx toFlat(StateIndx indx) const { return toFlat_.at(indx); }
+
+  StateIndx toState(StateIndx flat) const { return toState_.at(flat); }
+
+  void hit(StateIndx flat) noexcept { ++hits_[flat]; }
+
+  void renumber() {
+    IndxStorage order = toState_;
+    std::stable_sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+      return hits_[toFlat_[lhs]] > hits_[toFlat_[rhs]];
+    });
+    for (StateIndx flat = 0; flat != order.size(); ++flat) {
+      toState_[flat] = order[flat];
+      toFlat_[order[flat]] = flat;
+    }
+    std::fill(hits_.begin(), hits_.end(), size_t{0});
+    build();
+  }
+};
+
+template <typename TapeT>
+class BasicTuringMachine final
+    : public machines::Machine<BasicTuringMachine<TapeT>> {
+  using States = typename TapeT::States;
+  using Symbol = typename States::Symbol;
+  using StateVal = typename States::StateIndx;
+
+public:
+  using DumpLvl = typename machines::Machine<BasicTuringMachine>::DumpLvl;
+
+private:
+  States states_;
+  TapeT tape_;
+  unsigned macroSize_ = 0;
+  bool compiled_ = false;
+  size_t profileSteps_ = 0;
+  size_t dumpWindow_ = 0;
+
   void dumpTable(std::ostream &os) const { states_.dump(os); }
 
   void dumpState(std::ostream &os) const { tape_.dump(os, states_); }
 
-  void step() {
-    const auto &state = states_.getState(tape_.getCurStateIndx());
-    const auto &jump = state.jumps_[tape_.getHead()];
+  // Trace line, windowed around the head when a window is set.
+  void dumpStep(std::ostream &os) const {
+    if (dumpWindow_ != 0)
+      tape_.dumpWindow(os, states_, dumpWindow_);
+    else
+      dumpState(os);
+  }
+
+  static void step(const States &states, TapeT &tape) {
+    const auto &state = states.getState(tape.getCurStateIndx());
+    const auto &jump = state.jumps_[tape.getHead()];
     switch (jump.move_) {
     case States::Move::L:
-      tape_.moveLeft(jump.newSym_);
+      tape.moveLeft(jump.newSym_);
       break;
     case States::Move::R:
-      tape_.moveRight(jump.newSym_);
+      tape.moveRight(jump.newSym_);
       break;
     }
-    tape_.setCurStateIndx(jump.newStateIndx_);
+    tape.setCurStateIndx(jump.newStateIndx_);
   }
 
-  bool hlt() const noexcept { return states_.isHlt(tape_.getCurStateIndx()); }
+  void step() { step(states_, tape_); }
+
+  // Jumps over the head block when the head stands on one of its edges.
+  bool macroStep(BlockCache &cache) {
+    auto offset = tape_.blockOffset(macroSize_);
+    if (offset != 0 && offset + 1 != macroSize_)
+      return false;
+    tape_.reserveBlock(macroSize_);
+    auto block = tape_.readBlock(macroSize_);
+    const auto &jump = cache.get(tape_.getCurStateIndx(), block, offset != 0);
+    return tape_.jumpBlock(macroSize_, jump);
+  }
+
+  void runMacro() {
+    if constexpr (std::is_same_v<TapeT, PackedTape>) {
+      BlockCache cache{states_, macroSize_};
+      while (!hlt())
+        if (!macroStep(cache))
+          step();
+    } else {
+      auto msg = "Macro steps need the packed tape";
+      throw std::runtime_error(msg);
+    }
+  }
+
+  // A state that keeps its direction and its symbol crosses a whole run.
+  void runChains() {
+    while (!hlt()) {
+      auto stateIndx = tape_.getCurStateIndx();
+      const auto &jump = states_.getState(stateIndx).jumps_[tape_.getHead()];
+      if (jump.newStateIndx_ != stateIndx) {
+        step();
+      } else if (jump.move_ == States::Move::L) {
+        tape_.chainLeft(jump.newSym_);
+      } else {
+        tape_.chainRight(jump.newSym_);
+      }
+    }
+  }
+
+  // Steps on the flat table until halt or maxSteps, returns steps made.
+  template <bool Dump, bool Profile>
+  size_t runFlat(FlatTable &table, size_t maxSteps, std::ostream &os) {
+    const auto *jumps = table.data();
+    auto halt = table.toFlat(states_.getHaltIndx());
+    auto state = table.toFlat(tape_.getCurStateIndx());
+    size_t stepsCount = 0U;
+    for (; stepsCount != maxSteps && state != halt; ++stepsCount) {
+      if constexpr (Dump) {
+        tape_.setCurStateIndx(table.toState(state));
+        dumpStep(os);
+      }
+      if constexpr (Profile)
+        table.hit(state);
+      auto jump = jumps[FlatTable::indx(state, tape_.getHead())];
+      auto newSym = static_cast<Symbol>(jump & FlatTable::SymBit);
+      if (jump & FlatTable::RightBit)
+        tape_.moveRight(newSym);
+      else
+        tape_.moveLeft(newSym);
+      state = jump >> FlatTable::StateShift;
+    }
+    tape_.setCurStateIndx(table.toState(state));
+    return stepsCount;
+  }
+
+  // Profiles the first profileSteps_ steps, renumbers the states by their
+  // hits and goes on with the renumbered table.
+  size_t runCompiled(size_t maxSteps, std::ostream &os, DumpLvl lvl) {
+    if constexpr (States::SymbolsCount != 2U) {
+      auto msg = "Compiled steps need a binary alphabet";
+      throw std::runtime_error(msg);
+    } else {
+      FlatTable table{states_};
+      size_t stepsCount = 0U;
+      if (profileSteps_ != 0) {
+        auto profileSteps = std::min(profileSteps_, maxSteps);
+        stepsCount = lvl > 0 ? runFlat<true, true>(table, profileSteps, os)
+                             : runFlat<false, true>(table, profileSteps, os);
+        table.renumber();
+      }
+      maxSteps -= stepsCount;
+      stepsCount += lvl > 0 ? runFlat<true, false>(table, maxSteps, os)
+                            : runFlat<false, false>(table, maxSteps, os);
+      return stepsCount;
+    }
+  }
+
+  bool hlt() const noexcept { return hlt(states_, tape_); }
 
   friend class machines::TMConverter;
+  friend class machines::TMEnumerator;
+  friend class machines::LoweredTuringMachine;
 
 public:
+  void read(std::istream &is) {
+    states_.read(is);
+    tape_.read(is, states_);
+  }
+
+  // Sets up a machine built in memory.
+  void load(States states, const TapeImage &image) {
+    states_ = std::move(states);
+    tape_.load(image, states_);
+  }
+
+  // Steps until halt or until maxSteps steps are made, returns steps made.
+  size_t run(size_t maxSteps) {
+    if (compiled_) {
+      std::ostream null{nullptr};
+      return runCompiled(maxSteps, null, 0);
+    }
+    size_t stepsCount = 0U;
+    for (; stepsCount != maxSteps && !hlt(); ++stepsCount)
+      step();
+    return stepsCount;
+  }
+
+  // Runs the machine on blocks of size cells, 0 means plain steps.
+  void setMacroSize(unsigned size) { macroSize_ = size; }
+
+  // Runs plain steps on the flat table.
+  void setCompiled(bool compiled) { compiled_ = compiled; }
+
+  // Renumbers the flat table by the state hits of the first steps.
+  void setProfileSteps(size_t steps) {
+    profileSteps_ = steps;
+    compiled_ = compiled_ || steps != 0;
+  }
+
+  // Dumps only window cells on each side of the head while tracing.
+  void setDumpWindow(size_t window) { dumpWindow_ = window; }
+
+  // Sweeps share the states and give every initial tape its own TapeT.
+  using Config = TapeT;
+
+  static Config readConfig(const States &states, const std::string &initial) {
+    std::istringstream is{"initial:\n" + initial + "\n"};
+    TapeT tape;
+    tape.read(is, states);
+    return tape;
+  }
+
+  static size_t run(const States &states, TapeT &tape, size_t maxSteps) {
+    size_t stepsCount = 0U;
+    for (; stepsCount != maxSteps && !hlt(states, tape); ++stepsCount)
+      step(states, tape);
+    return stepsCount;
+  }
+
+  static bool hlt(const States &states, const TapeT &tape) noexcept {
+    return states.isHlt(tape.getCurStateIndx());
+  }
+
+  static void dumpConfig(std::ostream &os, const States &states,
+                         const TapeT &tape) {
+    tape.dump(os, states);
+  }
+
+  // Runs the program on every tape of the sweep, in the initial state of
+  // the program. Tapes of the length sweep take every head position, the
+  // numbers of the range have the head on their lowest digit.
+  void sweep(std::istream &is, std::ostream &os, const Sweep &sweep) {
+    states_.read(is);
+    TapeImage image;
+    image.read(is, states_);
+    const auto &symbols = states_.getAlphabet().symbols_;
+    auto toStr = [&symbols](const Sweep::Word &word) {
+      std::string str;
+      for (auto &&sym : word)
+        str.push_back(symbols[sym]);
+      return str;
+    };
+    auto state = "[" + image.stateName_ + "]";
+    Sweep::InitialStorage initials;
+    for (auto &&word : sweep.lengthWords(symbols.size())) {
+      auto str = toStr(word);
+      for (size_t head = 1; head <= str.size(); ++head)
+        initials.push_back(str.substr(0, head) + state + str.substr(head));
+    }
+    for (auto &&word : sweep.rangeWords(symbols.size()))
+      initials.push_back(toStr(word) + state);
+    sweep.run<BasicTuringMachine>(states_, initials, os);
+  }
+
   void execute(std::istream &is, std::ostream &os, DumpLvl lvl) {
     read(is);
     dumpTable(os);
+    if (macroSize_ != 0) {
+      if (lvl > 0) {
+        auto msg = "Macro steps can't be dumped step by step";
+        throw std::runtime_error(msg);
+      }
+      runMacro();
+    }
+    if constexpr (std::is_same_v<TapeT, RunLengthTape>) {
+      if (lvl == 0)
+        runChains();
+    }
+    if (compiled_)
+      runCompiled(std::numeric_limits<size_t>::max(), os, lvl);
     for (;;) {
       if (hlt())
         break;
       if (lvl > 0)
-        dumpState(os);
+        dumpStep(os);
       step();
     }
     dumpState(os);
@@ -319,6 +1542,111 @@ public:
   }
 };
 
+// Turing machine with the tape representation chosen at run time.
+class TuringMachine final : public machines::Machine<TuringMachine> {
+public:
+  enum class TapeKind {
+    Deque,
+    Packed,
+    RunLength,
+  };
+
+private:
+  std::optional<TapeKind> tapeKind_;
+  unsigned macroSize_ = 0;
+  bool compiled_ = false;
+  size_t profileSteps_ = 0;
+  size_t dumpWindow_ = 0;
+
+  template <typename TapeT, typename Action>
+  void dispatchTape(std::istream &is, Action &action) {
+    BasicTuringMachine<TapeT> tm;
+    tm.setMacroSize(macroSize_);
+    tm.setCompiled(compiled_);
+    tm.setProfileSteps(profileSteps_);
+    tm.setDumpWindow(dumpWindow_);
+    action(tm, is);
+  }
+
+  // The deque tape unless another one is given, the packed one for macro
+  // steps.
+  TapeKind getTapeKind() const {
+    if (tapeKind_)
+      return *tapeKind_;
+    return macroSize_ != 0 ? TapeKind::Packed : TapeKind::Deque;
+  }
+
+  template <unsigned Symbols, typename Action>
+  void dispatchAlphabet(std::istream &is, Action &action) {
+    switch (getTapeKind()) {
+    case TapeKind::Deque:
+      return dispatchTape<BasicDequeTape<Symbols>>(is, action);
+    case TapeKind::Packed:
+      return dispatchTape<BasicPackedTape<Symbols>>(is, action);
+    case TapeKind::RunLength:
+      if constexpr (Symbols == 2U) {
+        return dispatchTape<RunLengthTape>(is, action);
+      } else {
+        auto msg = "Run-length tape needs a binary alphabet";
+        throw std::runtime_error(msg);
+      }
+    }
+  }
+
+  // Calls action(tm, program) with the machine of the narrowest alphabet
+  // width that fits the program.
+  template <typename Action> void dispatch(std::istream &is, Action action) {
+    std::stringstream program;
+    program << is.rdbuf();
+    auto symbols = Alphabet::peek(program).size();
+    program.clear();
+    program.seekg(0);
+    if (symbols <= 2U)
+      return dispatchAlphabet<2U>(program, action);
+    if (symbols <= 4U)
+      return dispatchAlphabet<4U>(program, action);
+    if (symbols <= 16U)
+      return dispatchAlphabet<16U>(program, action);
+    return dispatchAlphabet<256U>(program, action);
+  }
+
+public:
+  static TapeKind strToTapeKind(std::string_view string) {
+    if (string == "deque") {
+      return TapeKind::Deque;
+    } else if (string == "packed") {
+      return TapeKind::Packed;
+    } else if (string == "rle") {
+      return TapeKind::RunLength;
+    } else {
+      auto msg = "Unknown tape '" + std::string(string) + "'";
+      throw std::runtime_error(msg);
+    }
+  }
+
+  void setTapeKind(TapeKind tapeKind) { tapeKind_ = tapeKind; }
+
+  void setMacroSize(unsigned size) { macroSize_ = size; }
+
+  void setCompiled(bool compiled) { compiled_ = compiled; }
+
+  void setProfileSteps(size_t steps) { profileSteps_ = steps; }
+
+  void setDumpWindow(size_t window) { dumpWindow_ = window; }
+
+  void execute(std::istream &is, std::ostream &os, DumpLvl lvl) {
+    dispatch(is, [&](auto &tm, std::istream &program) {
+      tm.execute(program, os, lvl);
+    });
+  }
+
+  void sweep(std::istream &is, std::ostream &os, const Sweep &sweep) {
+    dispatch(is, [&](auto &tm, std::istream &program) {
+      tm.sweep(program, os, sweep);
+    });
+  }
+};
+
 } // namespace tm
 
 } // namespace machines
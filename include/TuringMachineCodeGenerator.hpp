@@ -0,0 +1,195 @@
+#pragma once
+
+#include <sstream>
+
+#include "TuringMachine.hpp"
+
+namespace machines {
+
+// Emits a standalone C++ program running one Turing machine: every state is
+// a label, every jump a goto, and the tape is a byte per cell growing on both
+// sides. The program prints what ETM prints without dumping. Any alphabet is
+// accepted, a cell holds the index of its symbol.
+class TMCodeGenerator final
+    : public Converter<TMCodeGenerator, tm::TuringMachine> {
+  using States = tm::BasicStates<256U>;
+  using TapeImage = tm::TapeImage;
+  using StateIndx = States::StateIndx;
+  using Move = States::Move;
+  using Symbol = States::Symbol;
+  using IndxStorage = std::vector<bool>;
+
+  static std::string toLiteral(std::string_view str) {
+    std::string literal = "\"";
+    for (size_t i = 0; i != str.size(); ++i) {
+      auto sym = str[i];
+      switch (sym) {
+      case '\n':
+        literal += i + 1 == str.size() ? "\\n" : "\\n\"\n    \"";
+        break;
+      case '\t':
+        literal += "\\t";
+        break;
+      case '"':
+      case '\\':
+        literal.push_back('\\');
+        literal.push_back(sym);
+        break;
+      default:
+        literal.push_back(sym);
+      }
+    }
+    return literal + "\"";
+  }
+
+  static std::string label(StateIndx indx) {
+    return "s" + std::to_string(indx);
+  }
+
+  void writeHeader(std::ostream &os) const {
+    os << "// Generated by GTM, prints the same as ETM without --dump.\n";
+    os << "#include <cstddef>\n";
+    os << "#include <cstdio>\n";
+    os << "#include <string>\n";
+    os << "#include <vector>\n\n";
+  }
+
+  void writeData(const States &states, const TapeImage &image,
+                 std::ostream &os) const {
+    std::ostringstream table;
+    states.dump(table);
+    os << "namespace {\n\n";
+    os << "using Cells = std::vector<unsigned char>;\n\n";
+    os << "const char *const Table = " << toLiteral(table.str()) << ";\n\n";
+    os << "const char *const Names[] = {\n";
+    for (auto &&state : states)
+      os << "    " << toLiteral(state.name_) << ",\n";
+    os << "};\n\n";
+    const auto &symbols = states.getAlphabet().symbols_;
+    os << "const char Symbols[] = " << toLiteral(symbols) << ";\n\n";
+    os << "const unsigned char Initial[] = {";
+    for (auto &&sym : image.left_)
+      os << unsigned{sym} << ", ";
+    os << unsigned{image.head_};
+    for (auto &&sym : image.right_)
+      os << ", " << unsigned{sym};
+    os << "};\n\n";
+    os << "const std::size_t InitialHead = " << image.left_.size() << ";\n\n";
+  }
+
+  void writeHelpers(std::ostream &os) const {
+    os << R"(// Doubles the tape on the left, returns how far the cells moved.
+std::size_t growLeft(Cells &tape) {
+  auto added = tape.size();
+  tape.insert(tape.begin(), added, 0);
+  return added;
+}
+
+void growRight(Cells &tape) { tape.resize(2 * tape.size(), 0); }
+
+void dump(const Cells &tape, std::size_t lo, std::size_t head, std::size_t hi,
+          std::size_t state) {
+  std::string str;
+  for (auto pos = lo; pos <= head; ++pos)
+    str.push_back(Symbols[tape[pos]]);
+  str.append(1, '[').append(Names[state]).push_back(']');
+  for (auto pos = head + 1; pos <= hi; ++pos)
+    str.push_back(Symbols[tape[pos]]);
+  str.push_back('\n');
+  std::fputs(Table, stdout);
+  std::fputs(str.c_str(), stdout);
+}
+
+} // namespace
+
+)";
+  }
+
+  void writeMove(Move move, const std::string &indent, std::ostream &os) const {
+    if (move == Move::R) {
+      os << indent << "if (++head == tape.size()) {\n";
+      os << indent << "  growRight(tape);\n";
+      os << indent << "  cells = tape.data();\n";
+      os << indent << "}\n";
+      os << indent << "if (!cells[lo])\n";
+      os << indent << "  ++lo;\n";
+      os << indent << "if (hi < head)\n";
+      os << indent << "  hi = head;\n";
+    } else {
+      os << indent << "if (head == 0) {\n";
+      os << indent << "  auto added = growLeft(tape);\n";
+      os << indent << "  head += added, lo += added, hi += added;\n";
+      os << indent << "  cells = tape.data();\n";
+      os << indent << "}\n";
+      os << indent << "--head;\n";
+      os << indent << "if (!cells[hi])\n";
+      os << indent << "  --hi;\n";
+      os << indent << "if (head < lo)\n";
+      os << indent << "  lo = head;\n";
+    }
+  }
+
+  void writeJump(const States::Jump &jump, const std::string &indent,
+                 std::ostream &os) const {
+    os << indent << "cells[head] = " << unsigned{jump.newSym_} << ";\n";
+    writeMove(jump.move_, indent, os);
+    os << indent << "goto " << label(jump.newStateIndx_) << ";\n";
+  }
+
+  void writeMain(const States &states, const TapeImage &image,
+                 std::ostream &os) const {
+    auto initialIndx = states.getState(image.stateName_).indx_;
+    auto symbols = states.getAlphabet().size();
+    IndxStorage used(states.size());
+    used[initialIndx] = true;
+    for (auto &&state : states) {
+      if (states.isHlt(state.indx_))
+        continue;
+      for (size_t sym = 0; sym != symbols; ++sym)
+        used[state.jumps_[sym].newStateIndx_] = true;
+    }
+    os << "int main() {\n";
+    os << "  Cells tape(Initial, Initial + sizeof(Initial));\n";
+    os << "  auto *cells = tape.data();\n";
+    os << "  std::size_t lo = 0, head = InitialHead, hi = tape.size() - 1;\n";
+    os << "  goto " << label(initialIndx) << ";\n";
+    for (auto &&state : states) {
+      if (!used[state.indx_])
+        continue;
+      os << "\n" << label(state.indx_) << ": // " << state.name_ << "\n";
+      if (states.isHlt(state.indx_)) {
+        os << "  dump(tape, lo, head, hi, " << state.indx_ << ");\n";
+        os << "  return 0;\n";
+        continue;
+      }
+      if (symbols == 2U) {
+        os << "  if (cells[head]) {\n";
+        writeJump(state.jumps_[1], "    ", os);
+        os << "  }\n";
+      } else {
+        os << "  switch (cells[head]) {\n";
+        for (size_t sym = 1; sym != symbols; ++sym) {
+          os << "  case " << sym << ":\n";
+          writeJump(state.jumps_[sym], "    ", os);
+        }
+        os << "  }\n";
+      }
+      writeJump(state.jumps_[0], "  ", os);
+    }
+    os << "}\n";
+  }
+
+public:
+  void convert(std::istream &is, std::ostream &os) {
+    States states;
+    TapeImage image;
+    states.read(is);
+    image.read(is, states);
+    writeHeader(os);
+    writeData(states, image, os);
+    writeHelpers(os);
+    writeMain(states, image, os);
+  }
+};
+
+} // namespace machines
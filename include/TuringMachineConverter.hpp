@@ -1,6 +1,10 @@
 #pragma once
 
+#include <array>
+
+#include "TagSystem.hpp"
 #include "TuringMachine.hpp"
+#include "TuringMachineEncoder.hpp"
 
 namespace machines {
 
@@ -22,6 +26,8 @@ struct Tag final {
     Rkk,
   };
 
+  static constexpr auto TypesCount = static_cast<size_t>(TagType::Rkk) + 1;
+
   StateIndx stateIndx_;
   TagType type_;
 
@@ -169,8 +175,9 @@ struct Tag final {
   }
 };
 
-class TMConverter final : public Converter<TMConverter, tm::TuringMachine> {
-  using TuringMachine = tm::TuringMachine;
+class TMConverter final
+    : public Converter<TMConverter, tm::BasicTuringMachine<tm::Tape>> {
+  using TuringMachine = tm::BasicTuringMachine<tm::Tape>;
   using TagType = Tag::TagType;
   using TagStorage = Tag::TagStorage;
 
@@ -224,49 +231,90 @@ class TMConverter final : public Converter<TMConverter, tm::TuringMachine> {
 
   void writeInitial(const TuringMachine &tm, std::ostream &os) const {
     auto &&states = tm.states_;
-    auto &&tape = tm.tape_;
-    auto curStateIndx = tape.getCurStateIndx();
-    auto tagHk0 = Tag::get(curStateIndx, TagType::Hk0);
-    auto tagHk1 = Tag::get(curStateIndx, TagType::Hk1);
-    auto tagLk0 = Tag::get(curStateIndx, TagType::Lk0);
-    auto tagLk1 = Tag::get(curStateIndx, TagType::Lk1);
-    auto tagRk0 = Tag::get(curStateIndx, TagType::Rk0);
-    auto tagRk1 = Tag::get(curStateIndx, TagType::Rk1);
-    TagStorage appends;
     os << "initial:\n";
-    if (tape.getHead() == true) {
-      appends.emplace_back(tagHk1);
-      appends.emplace_back(tagHk0);
-      for (size_t i = 0; i != tape.leftNumber(); ++i) {
-        appends.emplace_back(tagLk1);
-        appends.emplace_back(tagLk0);
-      }
-      for (size_t i = 0; i != tape.rightNumber(); ++i) {
-        appends.emplace_back(tagRk1);
-        appends.emplace_back(tagRk0);
-      }
-    } else {
-      appends.emplace_back(tagHk0);
-      appends.emplace_back(tagHk1);
-      for (size_t i = 0; i != tape.leftNumber(); ++i) {
-        appends.emplace_back(tagLk0);
-        appends.emplace_back(tagLk1);
-      }
-      for (size_t i = 0; i != tape.rightNumber(); ++i) {
-        appends.emplace_back(tagRk0);
-        appends.emplace_back(tagRk1);
-      }
-      appends.pop_back();
-    }
-    for (auto &&tag : appends)
-      os << tag.toString(states) << " ";
+    visitQueue(tm, true,
+               [&](const Tag &tag) { os << tag.toString(states) << " "; });
     os << "\n";
   }
 
 public:
+  // Calls visit(Tag) for the tags of the queue encoding the configuration of
+  // the machine: the head pair, then a pair for every unit of the left and
+  // right tape numbers. Pairs of a 1 head go 1 first. The initial pairs of a 0
+  // head go 0 first and lose the very last tag, while a 0 head left by a step
+  // has a single head tag and pairs going 1 first. Tags read by the steps are
+  // the same in both.
+  template <typename Visit>
+  static void visitQueue(const TuringMachine &tm, bool initial, Visit visit) {
+    auto &&tape = tm.tape_;
+    auto curStateIndx = tape.getCurStateIndx();
+    auto head = tape.getHead();
+    auto left = tape.leftNumber(), right = tape.rightNumber();
+    auto zeroFirst = !head && initial;
+    auto size = 2 * (1 + left + right) - (head ? 0 : 1);
+    size_t count = 0U;
+    auto emit = [&](TagType type) {
+      if (count++ != size)
+        visit(Tag::get(curStateIndx, type));
+    };
+    auto pair = [&](TagType zero, TagType one) {
+      emit(zeroFirst ? zero : one);
+      emit(zeroFirst ? one : zero);
+    };
+    if (head || initial)
+      pair(TagType::Hk0, TagType::Hk1);
+    else
+      emit(TagType::Hk0);
+    for (size_t i = 0; i != left; ++i)
+      pair(TagType::Lk0, TagType::Lk1);
+    for (size_t i = 0; i != right; ++i)
+      pair(TagType::Rk0, TagType::Rk1);
+  }
+
+  // Queue the converted machine has when it starts to emulate the next step
+  // of the machine, tags being the converted ones. Steps tell whether the
+  // machine has left its initial configuration.
+  static ts::Queue lowerQueue(const TuringMachine &tm, const ts::Tags &tags,
+                              size_t steps) {
+    using TagIndx = ts::Tags::TagIndx;
+    using IndxStorage = std::array<TagIndx, Tag::TypesCount>;
+    auto &&states = tm.states_;
+    utils::EnumRange<TagType> range{TagType::Hk0, TagType::Rkk};
+    IndxStorage indxs;
+    for (auto &&tagType : range) {
+      auto tag = Tag::get(tm.tape_.getCurStateIndx(), tagType);
+      indxs[static_cast<size_t>(tagType)] =
+          tags.getTag(tag.toString(states)).indx_;
+    }
+    ts::Queue queue;
+    visitQueue(tm, steps == 0, [&](const Tag &tag) {
+      queue.append(&indxs[static_cast<size_t>(tag.type_)], 1U);
+    });
+    return queue;
+  }
+
+  // Program text of the machine, made binary by TMBinaryEncoder when it is
+  // over more than two symbols.
+  static std::stringstream readBinary(std::istream &is) {
+    std::stringstream program;
+    program << is.rdbuf();
+    auto symbols = tm::Alphabet::peek(program).size();
+    program.clear();
+    program.seekg(0);
+    if (symbols > 2U) {
+      std::stringstream binary;
+      TMBinaryEncoder encoder;
+      encoder.convert(program, binary);
+      program.swap(binary);
+    }
+    return program;
+  }
+
+  // Machines over more than two symbols are made binary by TMBinaryEncoder.
   void convert(std::istream &is, std::ostream &os) {
+    auto program = readBinary(is);
     TuringMachine tm;
-    tm.read(is);
+    tm.read(program);
     writeStates(tm, os);
     writeHalt(tm, os);
     writeTable(tm, os);
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <sstream>
+
+#include "TuringMachine.hpp"
+
+namespace machines {
+
+// Rewrites a machine over k > 2 symbols as a binary machine. A symbol becomes
+// a block of b = ceil(log2 k) cells holding its index, the highest bit first,
+// and the head of the binary machine stands on the first cell of the block
+// that holds the head of the original one. One step of a state q takes:
+//
+//   q, q~p     read the block moving right, p being the bits read so far;
+//   q~s~w<j>   write the new symbol moving left, j being the cell written;
+//   q~s~m<j>   move to the first cell of the next block, b - 1 cells to the
+//              left or b + 1 cells to the right, and enter the next state.
+//
+// Blocks of blanks are blank cells, so the binary tape grows like the original
+// one. Halting is kept: the binary machine halts right after the original
+// halting step, on the first cell of the block of the head.
+class TMBinaryEncoder final
+    : public Converter<TMBinaryEncoder, tm::TuringMachine> {
+  using States = tm::BasicStates<256U>;
+  using TapeImage = tm::TapeImage;
+  using Move = States::Move;
+
+  size_t width_;
+  size_t symbols_;
+
+  std::string toBits(size_t sym) const {
+    std::string bits;
+    for (size_t i = width_; i != 0; --i)
+      bits.push_back((sym >> (i - 1)) & 1U ? '1' : '0');
+    return bits;
+  }
+
+  static std::string readName(const std::string &name,
+                              const std::string &bits) {
+    return bits.empty() ? name : name + "~" + bits;
+  }
+
+  static std::string stepName(const std::string &name, const std::string &bits,
+                              char phase, size_t indx) {
+    return name + "~" + bits + "~" + phase + std::to_string(indx);
+  }
+
+  static void writeRow(const std::string &name, char sym, char newSym,
+                       const std::string &newName, Move move,
+                       std::ostream &os) {
+    os << name << "\t" << sym << "\t" << newSym << "\t" << newName << "\t";
+    os << (move == Move::L ? "L" : "R") << "\n";
+  }
+
+  // Row that keeps the symbol under the head for both binary symbols.
+  static void writeRows(const std::string &name, const std::string &newName,
+                        Move move, std::ostream &os) {
+    writeRow(name, '0', '0', newName, move, os);
+    writeRow(name, '1', '1', newName, move, os);
+  }
+
+  void writeStates(const States &states, std::ostream &os) const {
+    os << "states:\n";
+    for (auto &&state : states) {
+      os << state.name_ << "\t";
+      if (states.isHlt(state.indx_))
+        continue;
+      for (size_t len = 1; len != width_; ++len)
+        for (size_t prefix = 0; prefix != (1U << len); ++prefix)
+          os << readName(state.name_, toBits(prefix).substr(width_ - len))
+             << "\t";
+      for (size_t sym = 0; sym != symbols_; ++sym) {
+        const auto &jump = state.jumps_[sym];
+        auto bits = toBits(sym);
+        for (size_t j = 0; j + 1 != width_; ++j)
+          os << stepName(state.name_, bits, 'w', j) << "\t";
+        auto moves = jump.move_ == Move::L ? width_ - 1 : width_ + 1;
+        for (size_t j = 1; j <= moves; ++j)
+          os << stepName(state.name_, bits, 'm', j) << "\t";
+      }
+    }
+    os << "\n\n";
+  }
+
+  void writeHalt(const States &states, std::ostream &os) const {
+    os << "halt:\n";
+    os << states.getState(states.getHaltIndx()).name_ << "\n\n";
+  }
+
+  void writeRead(const States &states, const States::State &state,
+                 std::ostream &os) const {
+    const auto &haltName = states.getState(states.getHaltIndx()).name_;
+    for (size_t len = 0; len != width_; ++len) {
+      for (size_t prefix = 0; prefix != (1U << len); ++prefix) {
+        auto bits = toBits(prefix).substr(width_ - len);
+        auto name = readName(state.name_, bits);
+        for (auto bit : {'0', '1'}) {
+          auto newBits = bits + bit;
+          if (len + 1 != width_) {
+            writeRow(name, bit, bit, readName(state.name_, newBits), Move::R,
+                     os);
+            continue;
+          }
+          auto sym = std::stoul(newBits, nullptr, 2);
+          if (sym >= symbols_) {
+            writeRow(name, bit, bit, haltName, Move::R, os);
+            continue;
+          }
+          auto newSym = toBits(state.jumps_[sym].newSym_);
+          writeRow(name, bit, newSym.back(),
+                   stepName(state.name_, newBits, 'w', width_ - 2), Move::L,
+                   os);
+        }
+      }
+    }
+  }
+
+  void writeStep(const States &states, const States::State &state,
+                 std::ostream &os) const {
+    for (size_t sym = 0; sym != symbols_; ++sym) {
+      const auto &jump = state.jumps_[sym];
+      const auto &newName = states.getState(jump.newStateIndx_).name_;
+      auto bits = toBits(sym);
+      auto newSym = toBits(jump.newSym_);
+      for (size_t j = width_ - 1; j-- != 0;) {
+        auto name = stepName(state.name_, bits, 'w', j);
+        auto next = j != 0 ? stepName(state.name_, bits, 'w', j - 1)
+                           : stepName(state.name_, bits, 'm', 1);
+        writeRow(name, '0', newSym[j], next, Move::L, os);
+        writeRow(name, '1', newSym[j], next, Move::L, os);
+      }
+      auto moves = jump.move_ == Move::L ? width_ - 1 : width_ + 1;
+      for (size_t j = 1; j <= moves; ++j) {
+        auto name = stepName(state.name_, bits, 'm', j);
+        auto next =
+            j != moves ? stepName(state.name_, bits, 'm', j + 1) : newName;
+        writeRows(name, next, jump.move_, os);
+      }
+    }
+  }
+
+  void writeTable(const States &states, std::ostream &os) const {
+    os << "table:\n";
+    for (auto &&state : states) {
+      if (states.isHlt(state.indx_))
+        continue;
+      writeRead(states, state, os);
+      writeStep(states, state, os);
+    }
+    os << "\n\n";
+  }
+
+  void writeInitial(const TapeImage &image, std::ostream &os) const {
+    os << "initial:\n";
+    for (auto &&sym : image.left_)
+      os << toBits(sym);
+    auto head = toBits(image.head_);
+    os << head.front() << '[' << image.stateName_ << ']' << head.substr(1);
+    for (auto &&sym : image.right_)
+      os << toBits(sym);
+    os << "\n";
+  }
+
+public:
+  void convert(std::istream &is, std::ostream &os) {
+    States states;
+    TapeImage image;
+    states.read(is);
+    image.read(is, states);
+    symbols_ = states.getAlphabet().size();
+    width_ = 1;
+    while ((size_t{1} << width_) < symbols_)
+      ++width_;
+    if (width_ == 1) {
+      auto msg = "Machine is binary already";
+      throw std::runtime_error(msg);
+    }
+    writeStates(states, os);
+    writeHalt(states, os);
+    writeTable(states, os);
+    writeInitial(image, os);
+  }
+};
+
+} // namespace machines
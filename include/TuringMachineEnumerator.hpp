@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <sstream>
+
+#include "ThreadPool.hpp"
+#include "TuringMachine.hpp"
+
+namespace machines {
+
+// Enumerates the binary machines of n states A, B, ... in tree normal form.
+// A machine starts with no jumps on a blank tape and runs until it needs an
+// undefined jump. There the search branches: the jump halts, which gives a
+// halting machine, or it leads to one of the states used so far or to the
+// next unused one. Children go on from the configuration of their parent.
+// The first jump only moves right and leaves A, the mirrored machines and
+// the ones never leaving A being equivalent or endless.
+//
+// Every halting machine is written as one line:
+//
+//   1RB1LB_1LA1RZ<TAB>6<TAB>11[hlt]11
+//
+// that is the jumps of A, B, ... on 0 and 1 (--- for undefined ones, Z for
+// halt), the number of steps and the final tape. Lines go in the order of
+// the tree whatever the threads: a machine comes before its children, and
+// the halting child before the others, which go by the jump they define.
+class TMEnumerator final {
+  using TuringMachine = tm::BasicTuringMachine<tm::Tape>;
+  using States = tm::States;
+  using StateIndx = States::StateIndx;
+  using Symbol = States::Symbol;
+  using Jump = States::Jump;
+  using Move = States::Move;
+  using Mask = std::uint64_t;
+
+  static constexpr StateIndx HaltIndx = 0U;
+  static constexpr StateIndx MaxStates = 26U;
+
+  struct Node final {
+    TuringMachine tm_;
+    size_t steps_ = 0U;
+    StateIndx usedStates_ = 1U;
+    Mask defined_ = 0U;
+    // Indices of the children leading to the node from the root.
+    std::string path_;
+  };
+
+  // Line of a halting machine keyed by its path.
+  using Line = std::pair<std::string, std::string>;
+
+  struct Results final {
+    std::vector<Line> lines_;
+    size_t halting_ = 0U;
+    size_t undecided_ = 0U;
+    size_t maxSteps_ = 0U;
+  };
+
+  using Pool = WorkStealingPool<Node>;
+
+  StateIndx statesCount_;
+  size_t maxSteps_;
+  std::vector<Results> results_;
+
+  static std::string stateName(StateIndx indx) {
+    return indx == HaltIndx ? "hlt" : std::string(1, 'A' + indx - 1);
+  }
+
+  static Mask toMask(StateIndx indx, Symbol sym) noexcept {
+    return Mask{1} << (2 * (indx - 1) + sym);
+  }
+
+  Node makeRoot() const {
+    States states;
+    for (StateIndx indx = 0; indx <= statesCount_; ++indx)
+      states.addState(stateName(indx));
+    states.setHalt(HaltIndx);
+    tm::TapeImage image{{}, 0U, {}, stateName(1U)};
+    Node root;
+    root.tm_.load(std::move(states), image);
+    return root;
+  }
+
+  std::string toString(const Node &node) const {
+    const auto &states = node.tm_.states_;
+    std::string str;
+    for (StateIndx indx = 1; indx <= statesCount_; ++indx) {
+      if (indx != 1)
+        str.push_back('_');
+      for (auto sym : {false, true}) {
+        if (!(node.defined_ & toMask(indx, sym))) {
+          str.append("---");
+          continue;
+        }
+        const auto &jump = states.getState(indx).jumps_[sym];
+        str.push_back(states.symToStr(jump.newSym_));
+        str.push_back(jump.move_ == Move::L ? 'L' : 'R');
+        if (jump.newStateIndx_ == HaltIndx)
+          str.push_back('Z');
+        else
+          str.append(stateName(jump.newStateIndx_));
+      }
+    }
+    return str;
+  }
+
+  void defineJump(Node &node, StateIndx indx, Symbol sym,
+                  const Jump &jump) const {
+    node.tm_.states_.setJump(indx, sym, jump);
+    node.defined_ |= toMask(indx, sym);
+    node.usedStates_ = std::max(node.usedStates_, jump.newStateIndx_);
+  }
+
+  // Writes the machine whose undefined jump under the head halts.
+  void recordHalt(Node node, StateIndx indx, Symbol sym,
+                  Results &results) const {
+    defineJump(node, indx, sym, Jump{Move::R, true, HaltIndx});
+    node.tm_.step();
+    ++node.steps_;
+    std::ostringstream tape;
+    node.tm_.tape_.dump(tape, node.tm_.states_);
+    auto line = toString(node);
+    line.append(1, '\t').append(std::to_string(node.steps_));
+    line.append(1, '\t').append(tape.str());
+    node.path_.push_back(0);
+    results.lines_.emplace_back(std::move(node.path_), std::move(line));
+    ++results.halting_;
+    results.maxSteps_ = std::max(results.maxSteps_, node.steps_);
+  }
+
+  void branch(Node &node, Pool::Worker &worker, Results &results) const {
+    const auto &tape = node.tm_.tape_;
+    auto indx = tape.getCurStateIndx();
+    auto sym = tape.getHead();
+    recordHalt(node, indx, sym, results);
+    auto defined = static_cast<StateIndx>(__builtin_popcountll(node.defined_));
+    if (defined + 1 == 2 * statesCount_)
+      return;
+    auto lastState = std::min(node.usedStates_ + 1, statesCount_);
+    char child = 0;
+    for (StateIndx newIndx = 1; newIndx <= lastState; ++newIndx) {
+      for (auto newSym : {false, true}) {
+        for (auto move : {Move::L, Move::R}) {
+          if (node.steps_ == 0 && (move == Move::L || newIndx == indx))
+            continue;
+          auto next = node;
+          defineJump(next, indx, sym, Jump{move, newSym, newIndx});
+          next.path_.push_back(++child);
+          worker.push(std::move(next));
+        }
+      }
+    }
+  }
+
+  void process(Node &node, Pool::Worker &worker) {
+    auto &results = results_[worker.getIndx()];
+    const auto &tape = node.tm_.tape_;
+    for (; node.steps_ != maxSteps_; ++node.steps_) {
+      auto mask = toMask(tape.getCurStateIndx(), tape.getHead());
+      if (!(node.defined_ & mask))
+        return branch(node, worker, results);
+      node.tm_.step();
+    }
+    ++results.undecided_;
+  }
+
+public:
+  TMEnumerator(StateIndx statesCount, size_t maxSteps)
+      : statesCount_(statesCount), maxSteps_(maxSteps) {
+    if (statesCount_ == 0 || statesCount_ > MaxStates) {
+      auto msg = "States count must be in 1.." + std::to_string(MaxStates);
+      throw std::runtime_error(msg);
+    }
+  }
+
+  // Enumerates on the given number of threads and writes halting machines.
+  void enumerate(size_t threads, std::ostream &os) {
+    Pool pool{threads};
+    results_.assign(pool.size(), Results{});
+    std::vector<Node> roots;
+    roots.emplace_back(makeRoot());
+    pool.run(std::move(roots), [this](Node &node, Pool::Worker &worker) {
+      process(node, worker);
+    });
+    std::vector<Line> lines;
+    for (auto &&results : results_)
+      std::move(results.lines_.begin(), results.lines_.end(),
+                std::back_inserter(lines));
+    std::sort(lines.begin(), lines.end());
+    for (auto &&line : lines)
+      os << line.second;
+    os.flush();
+  }
+
+  void dumpSummary(std::ostream &os) const {
+    size_t halting = 0U, undecided = 0U, maxSteps = 0U;
+    for (auto &&results : results_) {
+      halting += results.halting_;
+      undecided += results.undecided_;
+      maxSteps = std::max(maxSteps, results.maxSteps_);
+    }
+    os << "halting: " << halting << "\n";
+    os << "undecided: " << undecided << "\n";
+    os << "max steps: " << maxSteps << std::endl;
+  }
+};
+
+} // namespace machines
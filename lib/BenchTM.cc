@@ -0,0 +1,32 @@
+#include "MiniPrograms.hpp"
+#include "TuringMachine.hpp"
+
+template <typename Tape> class CompiledTM final {
+  machines::tm::BasicTuringMachine<Tape> tm_;
+
+public:
+  CompiledTM() { tm_.setProfileSteps(1000000U); }
+
+  void read(std::istream &is) { tm_.read(is); }
+
+  size_t run(size_t maxSteps) { return tm_.run(maxSteps); }
+};
+
+auto main(int argc, const char* argv[]) -> int {
+  using DequeTM = machines::tm::BasicTuringMachine<machines::tm::DequeTape>;
+  using PackedTM = machines::tm::BasicTuringMachine<machines::tm::PackedTape>;
+  using RunLengthTM =
+      machines::tm::BasicTuringMachine<machines::tm::RunLengthTape>;
+  using CompiledDequeTM = CompiledTM<machines::tm::DequeTape>;
+  using CompiledPackedTM = CompiledTM<machines::tm::PackedTape>;
+  using BE = machines::MachineBenchmark<DequeTM, PackedTM, RunLengthTM,
+                                        CompiledDequeTM, CompiledPackedTM>;
+
+  try {
+    BE b{"Turing Machine",
+         {"deque", "packed", "rle", "deque flat", "packed flat"}};
+    b.run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
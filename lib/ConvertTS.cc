@@ -1,6 +1,19 @@
 #include "MiniPrograms.hpp"
 #include "TagSystemConverter.hpp"
 
+namespace machines {
+
+template <> struct MachineOptions<TSConverter> {
+  static void add(po::options_description &desc, TSConverter &cts) {
+    auto compact = [&cts](bool on) { cts.setCompact(on); };
+    desc.add_options()(
+        "compact", po::bool_switch()->notifier(compact),
+        "Give a block to every class of tags that act the same");
+  }
+};
+
+} // namespace machines
+
 auto main(int argc, const char* argv[]) -> int {
   using CTS = machines::TSConverter;
   using CO = machines::MachineConverter<CTS>;
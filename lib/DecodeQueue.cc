@@ -0,0 +1,29 @@
+#include "MiniPrograms.hpp"
+#include "QueueDecoder.hpp"
+
+namespace machines {
+
+template <> struct MachineOptions<QueueDecoder> {
+  static void add(po::options_description &desc, QueueDecoder &decoder) {
+    auto queue = [&decoder](const std::string &path) {
+      decoder.setQueuePath(path);
+    };
+    desc.add_options()(
+        "queue", po::value<std::string>()->notifier(queue),
+        "Dump of ETS, ECTS or LTM holding the queues to decode");
+  }
+};
+
+} // namespace machines
+
+auto main(int argc, const char* argv[]) -> int {
+  using DTM = machines::QueueDecoder;
+  using EX = machines::MachineExecutor<DTM>;
+
+  try {
+    EX e{"Queue Decoder"};
+    e.run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
@@ -0,0 +1,13 @@
+#include "MiniPrograms.hpp"
+#include "TuringMachineEnumerator.hpp"
+
+auto main(int argc, const char* argv[]) -> int {
+  using EN = machines::MachineEnumerator<machines::TMEnumerator>;
+
+  try {
+    EN e{"Turing Machine"};
+    e.run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
@@ -1,6 +1,21 @@
 #include "MiniPrograms.hpp"
 #include "CyclicTagSystem.hpp"
 
+namespace machines {
+
+template <> struct MachineOptions<cts::CyclicTagSystem> {
+  static void add(po::options_description &desc, cts::CyclicTagSystem &cts) {
+    auto spill = [&cts](size_t megabytes) { cts.setSpill(megabytes); };
+    auto unlimited = [&cts](bool unlimited) { cts.setUnlimited(unlimited); };
+    desc.add_options()("spill", po::value<size_t>()->notifier(spill),
+                       "Keep N MB of the queue in memory, spill the rest")(
+        "unlimited", po::bool_switch()->notifier(unlimited),
+        "Run without the limit of 10000 steps");
+  }
+};
+
+} // namespace machines
+
 auto main(int argc, const char* argv[]) -> int {
   using CTS = machines::cts::CyclicTagSystem;
   using EX = machines::MachineExecutor<CTS>;
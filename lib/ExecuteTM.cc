@@ -1,6 +1,32 @@
 #include "MiniPrograms.hpp"
 #include "TuringMachine.hpp"
 
+namespace machines {
+
+template <> struct MachineOptions<tm::TuringMachine> {
+  static void add(po::options_description &desc, tm::TuringMachine &tm) {
+    auto tape = [&tm](const std::string &kind) {
+      tm.setTapeKind(tm::TuringMachine::strToTapeKind(kind));
+    };
+    auto macro = [&tm](unsigned size) { tm.setMacroSize(size); };
+    auto compiled = [&tm](bool on) { tm.setCompiled(on); };
+    auto profile = [&tm](size_t steps) { tm.setProfileSteps(steps); };
+    auto window = [&tm](size_t cells) { tm.setDumpWindow(cells); };
+    desc.add_options()("tape", po::value<std::string>()->notifier(tape),
+                       "Tape representation: deque (default), packed or rle")(
+        "macro", po::value<unsigned>()->notifier(macro),
+        "Run on blocks of k cells with cached block steps, k in [12, 32]")(
+        "compiled", po::bool_switch()->notifier(compiled),
+        "Run plain steps on a flat transition table")(
+        "profile", po::value<size_t>()->notifier(profile),
+        "Renumber states of the flat table by hits of the first N steps")(
+        "window", po::value<size_t>()->notifier(window),
+        "Dump only N cells on each side of the head while tracing");
+  }
+};
+
+} // namespace machines
+
 auto main(int argc, const char* argv[]) -> int {
   using TM = machines::tm::TuringMachine;
   using EX = machines::MachineExecutor<TM>;
@@ -1,6 +1,33 @@
 #include "MiniPrograms.hpp"
 #include "TagSystem.hpp"
 
+namespace machines {
+
+template <> struct MachineOptions<ts::TagSystem> {
+  static void add(po::options_description &desc, ts::TagSystem &ts) {
+    auto rle = [&ts](bool on) { ts.setRunLength(on); };
+    auto passes = [&ts](bool on) { ts.setPasses(on); };
+    auto parallel = [&ts](size_t threads) { ts.setPassThreads(threads); };
+    auto grouped = [&ts](bool on) { ts.setGrouped(on); };
+    auto spill = [&ts](size_t megabytes) { ts.setSpill(megabytes); };
+    desc.add_options()("rle", po::bool_switch()->notifier(rle),
+                       "Keep the queue as runs and delete whole runs at once")(
+        "passes", po::bool_switch()->notifier(passes),
+        "Run generation by generation through two buffers")(
+        "parallel",
+        po::value<size_t>()
+            ->implicit_value(std::thread::hardware_concurrency())
+            ->notifier(parallel),
+        "Run passes on N threads, all cores by default")(
+        "grouped", po::bool_switch()->notifier(grouped),
+        "Dump the queue as groups of repeated m tags")(
+        "spill", po::value<size_t>()->notifier(spill),
+        "Keep N MB of the queue in memory and spill the rest to disk");
+  }
+};
+
+} // namespace machines
+
 auto main(int argc, const char* argv[]) -> int {
   using TS = machines::ts::TagSystem;
   using EX = machines::MachineExecutor<TS>;
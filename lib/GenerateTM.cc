@@ -0,0 +1,14 @@
+#include "MiniPrograms.hpp"
+#include "TuringMachineCodeGenerator.hpp"
+
+auto main(int argc, const char* argv[]) -> int {
+  using GTM = machines::TMCodeGenerator;
+  using CO = machines::MachineConverter<GTM>;
+
+  try {
+    CO c{"Turing Machine Code Generator"};
+    c.run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
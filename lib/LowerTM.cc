@@ -0,0 +1,34 @@
+#include "LoweredTuringMachine.hpp"
+#include "MiniPrograms.hpp"
+
+namespace machines {
+
+template <> struct MachineOptions<LoweredTuringMachine> {
+  static void add(po::options_description &desc, LoweredTuringMachine &ltm) {
+    using StepStorage = std::vector<size_t>;
+    auto at = [&ltm](const StepStorage &steps) { ltm.setCheckpoints(steps); };
+    auto resume = [&ltm](bool on) { ltm.setResume(on); };
+    auto grouped = [&ltm](bool on) { ltm.setGrouped(on); };
+    desc.add_options()(
+        "at", po::value<StepStorage>()->multitoken()->notifier(at),
+        "Steps to write the tag system queue at")(
+        "resume", po::bool_switch()->notifier(resume),
+        "Run the tag system from the last step until it halts")(
+        "grouped", po::bool_switch()->notifier(grouped),
+        "Dump queues as groups of repeated pairs");
+  }
+};
+
+} // namespace machines
+
+auto main(int argc, const char* argv[]) -> int {
+  using LTM = machines::LoweredTuringMachine;
+  using EX = machines::MachineExecutor<LTM>;
+
+  try {
+    EX e{"Lowered Turing Machine"};
+    e.run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+}
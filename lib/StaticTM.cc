@@ -0,0 +1,52 @@
+#include "StaticTuringMachine.hpp"
+
+// Runs the 4-state busy beaver at build time, so the static engine is
+// compiled and checked by every build.
+
+namespace {
+
+using namespace machines;
+
+constexpr std::string_view BusyBeaver4 = R"(
+states:
+hlt a b c d
+
+halt:
+hlt
+
+table:
+a 0 1 b R
+a 1 1 b L
+b 0 1 a L
+b 1 0 c L
+c 0 1 hlt R
+c 1 1 d L
+d 0 1 d R
+d 1 0 a R
+
+initial:
+0[a]
+)";
+
+constexpr auto table = tm::parseStaticTable<5>(BusyBeaver4);
+
+using BusyBeaver = tm::StaticTuringMachine<table>;
+
+struct Result final {
+  tm::StaticTape<32> tape_;
+  size_t steps_;
+};
+
+constexpr auto result = [] {
+  auto tape = tm::parseStaticTape<32>(BusyBeaver4, table);
+  auto steps = BusyBeaver::run(tape);
+  return Result{tape, steps};
+}();
+
+static_assert(result.steps_ == 107);
+static_assert(result.tape_.getCurStateIndx() == table.haltIndx_);
+static_assert(result.tape_.leftNumber() == 1U);
+static_assert(!result.tape_.getHead());
+static_assert(result.tape_.rightNumber() == 4095U);
+
+} // namespace